@@ -2,6 +2,7 @@
 #include <cmath>
 #include <fstream>
 #include <vector>
+#include <cstring>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -11,6 +12,17 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "asset_pack.h"
+#include "game_sim.h"
+#include "trajectory.h"
+#include "input_log.h"
+#include "triple_buffer.h"
+#include "sim_thread.h"
+#include "latency.h"
+#include "vblank.h"
+#include "offscreen.h"
+#include "capture.h"
+
 using namespace std;
 
 struct VAO {
@@ -32,6 +44,20 @@ struct GLMatrices {
 } Matrices;
 
 GLuint programID;
+GLuint pointProgramID, PointMatrixID, PointSizeID;
+float pixels_per_unit;
+AssetPack assets;
+
+/* Real time per simulation step. The game was tuned at 60 frames a second
+   with one step a frame */
+#define SIM_STEP (1.0/60)
+/* Most the simulation catches up on after a stall, beyond that it slows
+   down rather than running hundreds of steps at once */
+#define MAX_FRAME_TIME 0.25
+
+/* Dots in the aiming preview and the flight time between two of them */
+#define PREVIEW_POINTS 128
+#define PREVIEW_SPACING 0.05f
 
 /* Function to load Shaders - Use it as it is */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
@@ -40,9 +66,13 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-	// Read the Vertex Shader code from the file
+	// Read the Vertex Shader code from the asset pack, or from the file
+	AssetView VertexShaderView;
+	bool VertexInPack = asset_pack_find(&assets, vertex_file_path, &VertexShaderView);
 	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
+	std::ifstream VertexShaderStream;
+	if(!VertexInPack)
+		VertexShaderStream.open(vertex_file_path, std::ios::in);
 	if(VertexShaderStream.is_open())
 	{
 		std::string Line = "";
@@ -51,9 +81,13 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 		VertexShaderStream.close();
 	}
 
-	// Read the Fragment Shader code from the file
+	// Read the Fragment Shader code from the asset pack, or from the file
+	AssetView FragmentShaderView;
+	bool FragmentInPack = asset_pack_find(&assets, fragment_file_path, &FragmentShaderView);
 	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
+	std::ifstream FragmentShaderStream;
+	if(!FragmentInPack)
+		FragmentShaderStream.open(fragment_file_path, std::ios::in);
 	if(FragmentShaderStream.is_open()){
 		std::string Line = "";
 		while(getline(FragmentShaderStream, Line))
@@ -67,7 +101,12 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Compile Vertex Shader
 	printf("Compiling shader : %s\n", vertex_file_path);
 	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
+	GLint VertexSourceLength = VertexShaderCode.size();
+	if(VertexInPack) {
+		VertexSourcePointer = (char const *)VertexShaderView.data;
+		VertexSourceLength = VertexShaderView.size;
+	}
+	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , &VertexSourceLength);
 	glCompileShader(VertexShaderID);
 
 	// Check Vertex Shader
@@ -80,7 +119,12 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Compile Fragment Shader
 	printf("Compiling shader : %s\n", fragment_file_path);
 	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+	GLint FragmentSourceLength = FragmentShaderCode.size();
+	if(FragmentInPack) {
+		FragmentSourcePointer = (char const *)FragmentShaderView.data;
+		FragmentSourceLength = FragmentShaderView.size;
+	}
+	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , &FragmentSourceLength);
 	glCompileShader(FragmentShaderID);
 
 	// Check Fragment Shader
@@ -115,8 +159,21 @@ static void error_callback(int error, const char* description)
     fprintf(stderr, "Error: %s\n", description);
 }
 
+/* --capture writes every frame drawn to a file, see capture.h */
+Capture capture;
+bool capturing = false;
+
+/* Writes out the frames still in flight, the context has to be current */
+void stopCapture ()
+{
+  if(capturing)
+    capture_close(&capture);
+  capturing = false;
+}
+
 void quit(GLFWwindow *window)
 {
+    stopCapture();
     glfwDestroyWindow(window);
     glfwTerminate();
     exit(EXIT_SUCCESS);
@@ -201,97 +258,40 @@ void draw3DObject (struct VAO* vao)
 /**************************
  * Customizable functions *
  **************************/
- float canon_rotation = 90;
-glm::mat4 trnsfrm;
-int amm_amount=4;
-int num_appear=0;
-int num_coins=4;
-float time_travelled=0;
-float flag=0;
-float use=0;
-float velocity_x=(float)7*cos(canon_rotation*M_PI/180.0f);
-float velocity_y=(float)7*sin(canon_rotation*M_PI/180.0f);
-float position_x;
-float position_y;
-int bounce=0;
- void initlz()
-{
-trnsfrm = glm::mat4(1.0f);
-time_travelled=0;
-flag=0;
-velocity_x=(float)7*cos(canon_rotation*M_PI/180.0f);
-velocity_y=(float)7*sin(canon_rotation*M_PI/180.0f);
-position_x;
-position_y;
-bounce=0;
-}
-
-class coins{
-    public:int pos_x;
-    public:int pos_y;
-    public:int appear;
-public:
-    void set_coins(int x,int y)
-    {
-        pos_x=x;
-        pos_y=y;
-        appear=1;
-    }
+GameSim game;            // simulation thread only, once it has started
+InputLog input_log;
+
+/* What draw() shows of the game. The simulation thread publishes one after
+   every step, the render thread only ever reads these */
+struct Snapshot {
+    double time;                // when the step it was taken after was due
+    uint32_t tick;
+    uint32_t input_seq;         // newest input event applied
+    float canon_rotation;
+    bool barrage;
+    int num_projectiles;
+    vector<float> x, y, prev_x, prev_y;
+    int num_coins;              // only the ones still up
+    float coin_x[MAX_COINS];
+    float coin_y[MAX_COINS];
 };
-coins coin[4];
-void dist(coins coin[])
-{
-    for(int i=0;i<num_coins;i++)
-    {
-        if(abs(position_x-coin[i].pos_x)<=0.4f or abs(position_y-coin[i].pos_y)<=0.4f)
-            coin[i].appear=0;
-    }
-}
-void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
-{
+TripleBuffer<Snapshot> snapshots;
+SimThread sim;
+LatencyLog latency;
 
+// The game reads GLFW's key codes out of the input log
+static_assert(GAME_KEY_UP == GLFW_KEY_U && GAME_KEY_DOWN == GLFW_KEY_D &&
+              GAME_KEY_FIRE == GLFW_KEY_N && GAME_KEY_BARRAGE == GLFW_KEY_B &&
+              GAME_PRESS == GLFW_PRESS, "game keys must match GLFW's");
 
-    if (action == GLFW_RELEASE) {
-        switch (key) {
-            case GLFW_KEY_C:
-                
-                break;
-            case GLFW_KEY_P:
-                
-                break;
-            case GLFW_KEY_X:
-                // do something ..
-                break;
-            default:
-                break;
-        }
-    }
-    else if (action == GLFW_PRESS) {
-        switch (key) {
-            case GLFW_KEY_ESCAPE:
-                quit(window);
-                break;
-            case GLFW_KEY_U:
-                if(canon_rotation<90)
-                  canon_rotation+=10;
-                break;
-            case GLFW_KEY_D:
-                if(canon_rotation>0)
-                  canon_rotation-=10;
-                break;
-            case GLFW_KEY_N:
-                if(amm_amount>0)
-                {
-                    use=1;
-                    amm_amount--;
-                    initlz();
-                }
-
-
-            default:
-                break;
-        }
-    }
+/* Quitting takes effect at once, everything else goes through the input
+   log so a session can be recorded and replayed */
+void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action == GLFW_PRESS && key == GLFW_KEY_ESCAPE)
+        quit(window);
+    else
+        input_log_push(&input_log, INPUT_KEY, key, action, mods, 0, 0);
 }
 
 /* Executed for character input (like in text boxes) */
@@ -326,24 +326,33 @@ void mouseButton (GLFWwindow* window, int button, int action, int mods)
 }
 
 
-/* Executed when window is resized to 'width' and 'height' */
+/* Sets up drawing into a framebuffer of 'fbwidth' by 'fbheight' pixels */
 /* Modify the bounds of the screen here in glm::ortho or Field of View in glm::Perspective */
-void reshapeWindow (GLFWwindow* window, int width, int height)
+void resizeViewport (int fbwidth, int fbheight)
 {
-    int fbwidth=width, fbheight=height;
-    /* With Retina display on Mac OS X, GLFW's FramebufferSize
-     is different from WindowSize */
-    glfwGetFramebufferSize(window, &fbwidth, &fbheight);
-
 	GLfloat fov = 90.0f;
 
 	// sets the viewport of openGL renderer
 	glViewport (0, 0, (GLsizei) fbwidth, (GLsizei) fbheight);
 
     Matrices.projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 500.0f);
+    pixels_per_unit = fbheight / 10.0f;
 }
 
-VAO *rectangle,*canon,*gun,*bullet;
+/* Executed when window is resized to 'width' and 'height' */
+void reshapeWindow (GLFWwindow* window, int width, int height)
+{
+    int fbwidth=width, fbheight=height;
+    /* With Retina display on Mac OS X, GLFW's FramebufferSize
+     is different from WindowSize */
+    glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+    resizeViewport(fbwidth, fbheight);
+}
+
+VAO *rectangle,*canon,*gun,*bullet,*points,*preview;
+vector<GLfloat> point_data;
+TrajectoryCache trajectories;
+float preview_angle = -1;     // angle the preview buffer was filled for
 void createBullet()
 {
   static const GLfloat vertex_buffer_data[]={
@@ -634,10 +643,170 @@ void createRectangle()
     rectangle = create3DObject(GL_TRIANGLES,6,vertex_buffer_data,color_buffer_data,GL_FILL);
 }
 
+/* Applies the input logged for this step, then advances every projectile
+   by one fixed step of 0.01 game time, the amount draw() used to move the
+   bullet every frame */
+void simulateStep ()
+{
+  InputEvent event;
+  while(input_log_poll(&input_log, game.tick, &event))
+  {
+    game_sim_apply(&game, &event);
+    latency_applied(&latency, &event);
+  }
+  game_sim_step(&game);
+}
+
+/* Copies the state draw() needs into the snapshot buffer and hands it to
+   the render thread */
+void publishSnapshot (double time)
+{
+  Snapshot* s = triple_buffer_back(&snapshots);
+  s->time = time;
+  s->tick = game.tick;
+  s->input_seq = game.input_seq;
+  s->canon_rotation = game.canon_rotation;
+  s->barrage = game.barrage;
+  const Projectiles* p = &game.projectiles;
+  int n = p->count;
+  s->num_projectiles = n;
+  s->x.assign(p->x.begin(), p->x.begin()+n);
+  s->y.assign(p->y.begin(), p->y.begin()+n);
+  s->prev_x.assign(p->prev_x.begin(), p->prev_x.begin()+n);
+  s->prev_y.assign(p->prev_y.begin(), p->prev_y.begin()+n);
+  s->num_coins = 0;
+  for(int i=0;i<game.coins.count;i++)
+  {
+    if(game.coins.appear[i]!=0)
+    {
+      s->coin_x[s->num_coins] = game.coins.x[i];
+      s->coin_y[s->num_coins] = game.coins.y[i];
+      s->num_coins++;
+    }
+  }
+  triple_buffer_publish(&snapshots);
+}
+
+/* Runs on the simulation thread for the step due at 'time'. Stops it once
+   a replay has run out */
+bool runStep (double time)
+{
+  if(input_log_finished(&input_log, game.tick))
+    return false;
+  simulateStep();
+  publishSnapshot(time);
+  return true;
+}
+
+/* Registered with atexit, so quitting any way writes the recording */
+void saveInput ()
+{
+  input_log_save(&input_log, game.tick);
+}
+
+/* Registered with atexit after saveInput, so the recording is only written
+   once the thread has stopped adding to it */
+void stopSimulation ()
+{
+  sim_thread_stop(&sim);
+}
+
+/* Times the input events this frame is the first to show, see latency.h.
+   Called right after the swap, with the seq of the newest event shown */
+void timeFrame (uint32_t seq)
+{
+  static GLsync fences[LATENCY_FRAMES];
+  static int frame = 0;
+  double now = sim_thread_now();
+  // Earlier frames the GPU has finished since the last look
+  for(int i=0;i<LATENCY_FRAMES;i++)
+  {
+    if(fences[i] && glClientWaitSync(fences[i], 0, 0) != GL_TIMEOUT_EXPIRED)
+    {
+      latency_completed(&latency, i, now);
+      glDeleteSync(fences[i]);
+      fences[i] = 0;
+    }
+  }
+  // Only if the GPU is LATENCY_FRAMES behind, which would be worth knowing
+  if(fences[frame])
+  {
+    glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    latency_completed(&latency, frame, sim_thread_now());
+    glDeleteSync(fences[frame]);
+    fences[frame] = 0;
+  }
+  if(latency_swapped(&latency, frame, seq, now))
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame = (frame+1)%LATENCY_FRAMES;
+}
+
+/* Registered with atexit, writes the --latency histogram */
+void saveLatency ()
+{
+  latency_save(&latency);
+}
+
+/* Streams the projectiles, placed between their last two steps, into the
+   point buffer and draws them in one call */
+void drawProjectiles (glm::mat4 VP, const Snapshot* s, float alpha)
+{
+  int n = s->num_projectiles;
+  if(n==0)
+    return;
+  point_data.resize(3*n);
+  for(int i=0;i<n;i++)
+  {
+    point_data[3*i] = s->prev_x[i] + (s->x[i]-s->prev_x[i])*alpha;
+    point_data[3*i+1] = s->prev_y[i] + (s->y[i]-s->prev_y[i])*alpha;
+    point_data[3*i+2] = 0;
+  }
+
+  glUseProgram (pointProgramID);
+  glUniformMatrix4fv(PointMatrixID,1,GL_FALSE,&VP[0][0]);
+  glUniform1f(PointSizeID, 2*PROJECTILE_RADIUS*pixels_per_unit);
+  glBindBuffer (GL_ARRAY_BUFFER, points->VertexBuffer);
+  // Orphan last frame's storage so the upload does not wait for its draw
+  glBufferData (GL_ARRAY_BUFFER, 3*PROJECTILE_CAPACITY*sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+  glBufferSubData (GL_ARRAY_BUFFER, 0, 3*n*sizeof(GLfloat), &point_data[0]);
+  points->NumVertices = n;
+  draw3DObject(points);
+  glUseProgram (programID);
+}
+
+/* Dotted path a shot fired now would take. The buffer is only refilled
+   when the canon turns */
+void drawPreview (glm::mat4 VP, float canon_rotation)
+{
+  if(canon_rotation!=preview_angle)
+  {
+    const Trajectory * t = trajectory_for_shot(&trajectories, canon_rotation, SHOT_SPEED);
+    GLfloat data[3*PREVIEW_POINTS];
+    int n = 0;
+    for(; n<PREVIEW_POINTS && n*PREVIEW_SPACING<=t->end_time; n++)
+    {
+      trajectory_point(t, n*PREVIEW_SPACING, &data[3*n], &data[3*n+1]);
+      data[3*n+2] = 0;
+    }
+    glBindBuffer (GL_ARRAY_BUFFER, preview->VertexBuffer);
+    glBufferSubData (GL_ARRAY_BUFFER, 0, 3*n*sizeof(GLfloat), data);
+    preview->NumVertices = n;
+    preview_angle = canon_rotation;
+  }
+
+  glUseProgram (pointProgramID);
+  glUniformMatrix4fv(PointMatrixID,1,GL_FALSE,&VP[0][0]);
+  glUniform1f(PointSizeID, 0.3f*PROJECTILE_RADIUS*pixels_per_unit);
+  draw3DObject(preview);
+  glUseProgram (programID);
+}
+
 float camera_rotation_angle = 90;
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
-void draw ()
+/* 's' is the latest step, 'alpha' how far the frame lies between it and
+   the next one */
+void draw (const Snapshot* s, float alpha)
 {
   // clear the color and depth in the frame buffer
   glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -670,7 +839,7 @@ void draw ()
   // Load identity to model matrix
   Matrices.model =glm::mat4(1.0f);
   glm::mat4 translateCanon =glm::translate(glm::vec3(-4.0f,-4.0f,0.0f));
-  glm::mat4 rotateCanon =glm::rotate((float)(canon_rotation*M_PI/180.0f),glm::vec3(0,0,1));
+  glm::mat4 rotateCanon =glm::rotate((float)(s->canon_rotation*M_PI/180.0f),glm::vec3(0,0,1));
   glm::mat4 scaleCanon=glm::scale(glm::vec3(0.5f,0.5f,0.5f));
   glm::mat4 Canontransform = (translateCanon*rotateCanon*scaleCanon);
   Matrices.model*=Canontransform;
@@ -680,83 +849,18 @@ void draw ()
   draw3DObject(canon);
 
 
-  if (num_appear==0)
-  {
-    coin[0].set_coins(3,3);
-    coin[1].set_coins(4,1);
-    coin[2].set_coins(2,4);
-    coin[3].set_coins(2,2);
-    num_appear++;
-  }
-  
-  for(int i=0;i<num_coins;i++)
+  for(int i=0;i<s->num_coins;i++)
   {
     Matrices.model=glm::mat4(1.0f);
-    if(coin[i].appear!=0)
-    {
-        Matrices.model*=(glm::translate(glm::vec3(coin[i].pos_x,coin[i].pos_y,0))*glm::scale(glm::vec3(0.2f,0.2f,0)));
-        MVP=VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(bullet);
-    }
+    Matrices.model*=(glm::translate(glm::vec3(s->coin_x[i],s->coin_y[i],0))*glm::scale(glm::vec3(COIN_RADIUS,COIN_RADIUS,0)));
+    MVP=VP*Matrices.model;
+    glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
+    draw3DObject(bullet);
   }
 
 
-  //glm::mat4 translateBullet = glm::translate(glm::vec3(1,0,0.0f));
-  Matrices.model = glm::mat4(1.0f);
-  glm::mat4 translateBullet = glm::translate(glm::vec3(-4+1.2f*cos(canon_rotation*M_PI/180.0f),-4+1.2f*sin(canon_rotation*M_PI/180.0f),0));
-  glm::mat4 scaleBullet = glm::scale(glm::vec3(0.2,0.2,0));
-  glm::mat4 antirotateBullet =glm::rotate((float)((360-canon_rotation)*M_PI/180.0f),glm::vec3(0,0,1));
-  if(use!=0)
-  {
-    if (flag==0)
-     {
-        initlz();
-        trnsfrm=translateBullet;
-        //trnsfrm=(translateCanon*rotateCanon*translateBullet*antirotateBullet);
-        //trnsfrm=(translateCanon*rotateCanon*translateBullet*scaleBullet);
-        Matrices.model*=(trnsfrm*scaleBullet);
-        position_x=0;
-        position_y=0;
-        flag=1;
-    }
-    else
-    {
-        position_x+=0.01f*velocity_x;
-        position_y+=0.01f*(velocity_y+5-(10*time_travelled));
-    
-        if(position_y<=-(0.3f+1.0f*sin(canon_rotation*M_PI/180.0f)))
-        {
-            if(bounce<5)
-            {
-                velocity_y=0.5f*velocity_y;
-                bounce++;
-            }
-            time_travelled=0;
-        if(bounce>=5)
-        {
-            use=0;
-        }
-
-        }
-        else if(position_x>=(8-cos(canon_rotation*M_PI/180.0f)))
-        {
-
-            velocity_x=-0.5f*velocity_x;
-        }
-        glm::mat4 moveBullet = glm::translate(glm::vec3(position_x,position_y,0));
-        Matrices.model*=(trnsfrm*moveBullet*scaleBullet);
-    // if(position_x>=10-(0.5f+cos(canon_rotation*M_PI/180.0f)) or (position_x<=-(0.5+cos(canon_rotation*M_PI/180.0f))))
-     //   velocity_x*=-0.5f;
-        time_travelled+=0.01;
-        dist(coin);
-        MVP=VP*Matrices.model;
-    //time_x+=0.5;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(bullet);
-    }
-
-   } 
+  drawPreview(VP, s->canon_rotation);
+  drawProjectiles(VP, s, alpha);
 /***** WALLS******/
 
   Matrices.model = glm::mat4(1.0f);
@@ -841,7 +945,8 @@ GLFWwindow* initGLFW (int width, int height)
 
 /* Initialize the OpenGL rendering properties */
 /* Add all the models to be created here */
-void initGL (GLFWwindow* window, int width, int height)
+/* 'width' and 'height' are of the framebuffer drawn into */
+void initGL (int width, int height)
 {
     /* Objects should be created before any other gl function and shaders */
 	// Create the models
@@ -849,13 +954,23 @@ void initGL (GLFWwindow* window, int width, int height)
   createCanon();
   createBullet();
   createRectangle();
+  // Vertex positions are streamed in every frame by drawProjectiles
+  points = create3DObject(GL_POINTS, PROJECTILE_CAPACITY, NULL, 1.0f, 0.8f, 0.2f, GL_FILL);
+  preview = create3DObject(GL_POINTS, PREVIEW_POINTS, NULL, 0.9f, 0.9f, 0.9f, GL_FILL);
+  // Rewritten by drawPreview whenever the canon turns
+  glBindBuffer (GL_ARRAY_BUFFER, preview->VertexBuffer);
+  glBufferData (GL_ARRAY_BUFFER, 3*PREVIEW_POINTS*sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
 	// Create and compile our GLSL program from the shaders
 	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
 	// Get a handle for our "MVP" uniform
 	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+	pointProgramID = LoadShaders( "Sample_GL_point.vert", "Sample_GL_point.frag" );
+	PointMatrixID = glGetUniformLocation(pointProgramID, "MVP");
+	PointSizeID = glGetUniformLocation(pointProgramID, "PointSize");
+	glEnable (GL_PROGRAM_POINT_SIZE);
 
 	
-	reshapeWindow (window, width, height);
+	resizeViewport (width, height);
 
     // Background color of the scene
 	glClearColor (0.3f, 0.3f, 0.3f, 0.0f); // R, G, B, A
@@ -870,28 +985,202 @@ void initGL (GLFWwindow* window, int width, int height)
     cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
 
+/* --headless: runs up to 'ticks' steps as fast as they go, without a
+   window or GL, then prints the rate and where the game ended up. A replay
+   that runs out first stops it early */
+int runHeadless (uint32_t ticks)
+{
+  double start = sim_thread_now();
+  while(game.tick < ticks && !input_log_finished(&input_log, game.tick))
+    simulateStep();
+  double elapsed = sim_thread_now() - start;
+
+  printf("%u ticks in %.3f s, %.0f ticks/s\n", game.tick, elapsed, elapsed > 0 ? game.tick / elapsed : 0);
+  printf("canon %.0f degrees, %d shots left, barrage %s\n", game.canon_rotation, game.ammo, game.barrage ? "on" : "off");
+  printf("%d projectiles in flight, %d of %d coins up\n", game.projectiles.count, game_sim_coins_up(&game), game.coins.count);
+  printf("checksum %08x\n", game_sim_checksum(&game));
+  return 0;
+}
+
+Offscreen offscreen;
+
+/* One frame of --offscreen: a step of the game, then the frame showing it.
+   False once a replay has run out, as in runStep() */
+bool offscreenFrame ()
+{
+  if(input_log_finished(&input_log, game.tick))
+    return false;
+  simulateStep();
+  publishSnapshot(sim_thread_now());
+  triple_buffer_update(&snapshots);
+  draw(triple_buffer_front(&snapshots), 1);
+  if(capturing)
+    capture_frame(&capture);
+  return true;
+}
+
+/* --offscreen WxH: draws 'frames' frames into a framebuffer of that size,
+   with no window, and prints how long they took */
+int runOffscreen (int width, int height, int frames, const char* capture_path)
+{
+  if(!offscreen_open(&offscreen, width, height))
+    return 1;
+  gladLoadGLLoader((GLADloadproc) offscreen_proc_address);
+  initGL (width, height);
+  triple_buffer_init(&snapshots);
+  publishSnapshot(sim_thread_now());
+  triple_buffer_update(&snapshots);
+  if(capture_path)
+    capturing = capture_open(&capture, capture_path, width, height, 60, offscreen_proc_address);
+  offscreen_bench(&offscreen, frames, offscreenFrame);
+  stopCapture();
+  offscreen_close(&offscreen);
+  return 0;
+}
+
 int main (int argc, char** argv)
 {
 	int width = 800;
 	int height = 800;
 
+    // Shaders come from assets.pak when it is present, loose files otherwise
+    asset_pack_open(&assets, "assets.pak");
+
+    // --record writes the session's input to a file, --replay plays one back,
+    // --latency writes a histogram of how long input took to show
+    input_log_init(&input_log);
+    latency_init(&latency);
+    for(int i=1;i+1<argc;i++)
+    {
+      if(strcmp(argv[i], "--record") == 0)
+        input_log_record(&input_log, argv[i+1]);
+      else if(strcmp(argv[i], "--replay") == 0 && !input_log_replay(&input_log, argv[i+1]))
+        return 1;
+      else if(strcmp(argv[i], "--latency") == 0)
+        latency_record(&latency, argv[i+1]);
+    }
+    atexit(saveInput);
+    atexit(saveLatency);
+    // --late reads input and steps the game just before the refresh that
+    // shows it, instead of right after the last swap. --headless --ticks N
+    // runs N steps with no window, --barrage starts with the barrage on.
+    // --offscreen WxH --frames N times drawing N frames of that size.
+    // --capture file.y4m or file.png writes out the frames drawn
+    bool late_sampling = false, headless = false;
+    const char* capture_path = NULL;
+    uint32_t ticks = 600;
+    int offscreen_width = 0, offscreen_height = 0, frames = 300;
+    for(int i=1;i<argc;i++)
+    {
+      if(strcmp(argv[i], "--late") == 0)
+        late_sampling = true;
+      else if(strcmp(argv[i], "--headless") == 0)
+        headless = true;
+      else if(strcmp(argv[i], "--ticks") == 0 && i+1<argc)
+        ticks = strtoul(argv[i+1], NULL, 10);
+      else if(strcmp(argv[i], "--capture") == 0 && i+1<argc)
+        capture_path = argv[i+1];
+      else if(strcmp(argv[i], "--frames") == 0 && i+1<argc)
+        frames = atoi(argv[i+1]);
+      else if(strcmp(argv[i], "--offscreen") == 0 && (i+1==argc ||
+              !offscreen_parse_size(argv[i+1], &offscreen_width, &offscreen_height)))
+      {
+        cout << "--offscreen takes a size like 1920x1080" << endl;
+        return 1;
+      }
+    }
+
+    // Set up before the first step, a replay has to start from the same
+    // state. --barrage goes in as a press of the key on the first step, so
+    // a recording keeps it and a replay takes it from the recording
+    game_sim_init(&game);
+    for(int i=1;i<argc;i++)
+      if(strcmp(argv[i], "--barrage") == 0)
+        input_log_inject(&input_log, INPUT_KEY, GAME_KEY_BARRAGE, GAME_PRESS);
+    if(headless)
+      return runHeadless(ticks);
+    if(offscreen_width > 0)
+      return runOffscreen(offscreen_width, offscreen_height, frames, capture_path);
+
     GLFWwindow* window = initGLFW(width, height);
 
-	initGL (window, width, height);
+    int fbwidth, fbheight;
+    glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+	initGL (fbwidth, fbheight);
+    if(capture_path)
+    {
+      // Frames are read at the size the framebuffer is now, so the window
+      // stays that size. With the swap interval at 1 a frame is drawn
+      // every refresh, which is the rate the video plays back at
+      int window_width, window_height;
+      glfwGetWindowSize(window, &window_width, &window_height);
+      glfwSetWindowSizeLimits(window, window_width, window_height, window_width, window_height);
+      const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+      int fps = mode && mode->refreshRate > 0 ? mode->refreshRate : 60;
+      capturing = capture_open(&capture, capture_path, fbwidth, fbheight, fps, (void* (*)(const char*)) glfwGetProcAddress);
+    }
+
+    // The game runs on its own thread from here on, draw() only sees the
+    // snapshots it publishes. Sampling late, the loop below runs the steps
+    // itself, right after reading the input
+    triple_buffer_init(&snapshots);
+    publishSnapshot(sim_thread_now());
+    triple_buffer_update(&snapshots);
+    VblankPredictor vblank;
+    if(late_sampling)
+    {
+      const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+      vblank_init(&vblank, 1.0 / (mode && mode->refreshRate > 0 ? mode->refreshRate : 60));
+      sim_thread_manual(&sim, SIM_STEP, MAX_FRAME_TIME, runStep);
+    }
+    else
+      sim_thread_start(&sim, SIM_STEP, MAX_FRAME_TIME, runStep);
+    atexit(stopSimulation);
 
     double last_update_time = glfwGetTime(), current_time;
+    double replay_start = sim_thread_now();
 
     /* Draw in loop */
     while (!glfwWindowShouldClose(window)) {
 
-        // OpenGL Draw commands
-        draw();
+        // When the frame about to be drawn reaches the screen
+        double shown = sim_thread_now();
+        double frame_start = shown;
+        if (late_sampling) {
+            shown = vblank_next(&vblank, shown);
+            vblank_sleep_until(shown - vblank_lead(&vblank));
+            frame_start = sim_thread_now();
+            glfwPollEvents();
+            // Every step due by the time the frame is shown, so the input
+            // just read is in it
+            sim_thread_run_due(&sim, shown);
+        }
+
+        triple_buffer_update(&snapshots);
+        const Snapshot* s = triple_buffer_front(&snapshots);
+        if (sim.finished) {
+            triple_buffer_update(&snapshots);
+            s = triple_buffer_front(&snapshots);
+            printf("Replayed %u steps in %.2f s\n", s->tick, sim_thread_now() - replay_start);
+            break;
+        }
+
+        // OpenGL Draw commands, placed between the last step and the next
+        // one so motion stays smooth whatever the frame rate
+        draw(s, min(max((shown - s->time) / SIM_STEP, 0.0), 1.0));
+        if (capturing)
+            capture_frame(&capture);
 
         // Swap Frame Buffer in double buffering
+        double submit = sim_thread_now();
         glfwSwapBuffers(window);
+        if (late_sampling)
+            vblank_swapped(&vblank, frame_start, submit, sim_thread_now());
+        timeFrame(s->input_seq);
 
         // Poll for Keyboard and mouse events
-        glfwPollEvents();
+        if (!late_sampling)
+            glfwPollEvents();
 
         // Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
         current_time = glfwGetTime(); // Time in seconds
@@ -901,6 +1190,8 @@ int main (int argc, char** argv)
         }
     }
 
+    stopCapture();
     glfwTerminate();
+    asset_pack_close(&assets);
     exit(EXIT_SUCCESS);
 }
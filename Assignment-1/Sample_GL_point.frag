@@ -0,0 +1,16 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec3 fragColor;
+
+// output data
+out vec3 color;
+
+void main()
+{
+    // Round off the square a point is drawn as
+    vec2 d = gl_PointCoord - vec2(0.5);
+    if (dot(d, d) > 0.25)
+        discard;
+    color = fragColor;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// input data : sent from main program
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec3 vertexColor;
+
+uniform mat4 MVP;
+uniform float PointSize; // diameter in pixels
+
+// output data : used by fragment shader
+out vec3 fragColor;
+
+void main ()
+{
+    fragColor = vertexColor;
+    gl_PointSize = PointSize;
+    gl_Position = MVP * vec4(vertexPosition, 1);
+}
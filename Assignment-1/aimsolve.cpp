@@ -0,0 +1,197 @@
+/* Finds the canon shots that collect the most coins, on every core.
+ *
+ *   usage: aimsolve [-t threads] [-a angles] [-s speeds] [-n best] [coins.txt]
+ *
+ * Fires a shot for every pair on a grid of 'angles' canon angles over 0-90
+ * degrees and 'speeds' speeds over MIN_SPEED-MAX_SPEED, and follows each one
+ * through the game's own projectile and coin code until it bounces out.
+ * coins.txt holds one "x y" coin per line, the game's four coins are used
+ * without it. Coins are counted per shot, one shot never takes a coin from
+ * another. Prints the best shots, how many shots collect each number of
+ * coins and the shot rate, which doubles as a benchmark of the physics.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "projectiles.h"
+#include "collide.h"
+
+using namespace std;
+
+#define MIN_SPEED 1.0f
+#define MAX_SPEED 15.0f
+
+struct Sweep {
+    int angles;
+    int speeds;
+    Coins coins;
+    CoinGrid grid;              // built once, only read by the workers
+    vector<int> collected;      // coins per shot, angle major
+    atomic<int> next;           // next angle to fire
+};
+
+static float sweep_value(int i, int count, float lo, float hi)
+{
+    return count == 1 ? lo : lo + (hi - lo)*i / (count - 1);
+}
+
+/* Every speed at one angle, flown together so the pool update runs over the
+   shots four at a time */
+static void fire_angle(Sweep * sweep, int a, Projectiles * p, vector<unsigned char> & hit)
+{
+    float angle = sweep_value(a, sweep->angles, 0, 90);
+    int num_coins = sweep->coins.count;
+    projectiles_init(p, sweep->speeds);
+    for (int s=0; s<sweep->speeds; s++) {
+        Body b = canon_launch(angle, sweep_value(s, sweep->speeds, MIN_SPEED, MAX_SPEED));
+        projectiles_spawn(p, b.x, b.y, b.vx, b.vy);
+    }
+    hit.assign((size_t)sweep->speeds*num_coins, 0);
+
+    int found[MAX_COINS];
+    while (p->count > 0) {
+        projectiles_step(p, PROJECTILE_STEP);
+        for (int i=0; i<p->count; i++) {
+            int n = coin_grid_touching(&sweep->grid, &sweep->coins, p->x[i], p->y[i], found, MAX_COINS);
+            for (int k=0; k<n; k++)
+                hit[(size_t)p->id[i]*num_coins + found[k]] = 1;
+        }
+    }
+
+    for (int s=0; s<sweep->speeds; s++) {
+        int total = 0;
+        for (int c=0; c<num_coins; c++)
+            total += hit[(size_t)s*num_coins + c];
+        sweep->collected[(size_t)a*sweep->speeds + s] = total;
+    }
+}
+
+static void worker(Sweep * sweep)
+{
+    Projectiles p;
+    vector<unsigned char> hit;
+    for (int a; (a = sweep->next++) < sweep->angles; )
+        fire_angle(sweep, a, &p, hit);
+}
+
+static bool load_coins(Coins * coins, const char * path)
+{
+    FILE * in = fopen(path, "r");
+    if (!in) {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+    char buffer[256];
+    int line = 0;
+    bool ok = true;
+    while (ok && fgets(buffer, sizeof(buffer), in)) {
+        line++;
+        char * hash = strchr(buffer, '#');
+        if (hash)
+            *hash = 0;
+        float x, y;
+        int n = sscanf(buffer, "%f %f", &x, &y);
+        if (n <= 0)
+            continue;
+        if (n != 2 || fabsf(x) > ARENA_INNER || fabsf(y) > ARENA_INNER) {
+            printf("%s:%d: expected a coin inside the arena as \"x y\"\n", path, line);
+            ok = false;
+        }
+        else if (!coins_add(coins, x, y)) {
+            printf("%s:%d: more than %d coins\n", path, line, MAX_COINS);
+            ok = false;
+        }
+    }
+    fclose(in);
+    return ok;
+}
+
+static int usage(const char * name)
+{
+    printf("usage: %s [-t threads] [-a angles] [-s speeds] [-n best] [coins.txt]\n", name);
+    return 1;
+}
+
+int main (int argc, char** argv)
+{
+    Sweep sweep;
+    sweep.angles = 91;
+    sweep.speeds = 141;
+    sweep.coins.count = 0;
+    int threads = 0, best = 10;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (i + 1 == argc)
+            return usage(argv[0]);
+        if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-a") == 0)
+            sweep.angles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0)
+            sweep.speeds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0)
+            best = atoi(argv[++i]);
+        else
+            return usage(argv[0]);
+    }
+    if (argc - i > 1 || sweep.angles <= 0 || sweep.speeds <= 0 || best < 0)
+        return usage(argv[0]);
+    if (i < argc) {
+        if (!load_coins(&sweep.coins, argv[i]))
+            return 1;
+    }
+    else {
+        // Where the game puts them
+        coins_add(&sweep.coins, 3, 3);
+        coins_add(&sweep.coins, 4, 1);
+        coins_add(&sweep.coins, 2, 4);
+        coins_add(&sweep.coins, 2, 2);
+    }
+    coin_grid_init(&sweep.grid);
+    coin_grid_build(&sweep.grid, &sweep.coins);
+
+    if (threads <= 0)
+        threads = thread::hardware_concurrency();
+    threads = max(1, min(threads, sweep.angles));
+    int shots = sweep.angles*sweep.speeds;
+    sweep.collected.assign(shots, 0);
+    sweep.next = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t=1; t<threads; t++)
+        workers.push_back(thread(worker, &sweep));
+    worker(&sweep);
+    for (size_t t=0; t<workers.size(); t++)
+        workers[t].join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Most coins first, then the lowest angle and speed
+    vector<int> order(shots);
+    for (int n=0; n<shots; n++)
+        order[n] = n;
+    stable_sort(order.begin(), order.end(), [&](int l, int r) { return sweep.collected[l] > sweep.collected[r]; });
+    for (int n=0; n<best && n<shots; n++) {
+        int shot = order[n];
+        printf("angle %5.1f  speed %5.2f  %d coins\n",
+               sweep_value(shot / sweep.speeds, sweep.angles, 0, 90),
+               sweep_value(shot % sweep.speeds, sweep.speeds, MIN_SPEED, MAX_SPEED),
+               sweep.collected[shot]);
+    }
+
+    vector<int> histogram(sweep.coins.count + 1, 0);
+    for (int n=0; n<shots; n++)
+        histogram[sweep.collected[n]]++;
+    for (int c=0; c<=sweep.coins.count; c++)
+        if (histogram[c])
+            printf("%d shots collect %d of %d coins\n", histogram[c], c, sweep.coins.count);
+    printf("%d shots, %.0f shots/s on %d threads\n", shots, shots / seconds, threads);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef BALLISTICS_H
+#define BALLISTICS_H
+
+#include <math.h>
+
+/* Closed form times of impact for a body under constant gravity 'g' inside
+ * an axis aligned box, y(t) = y + vy*t - g*t*t/2 and x(t) = x + vx*t. Each
+ * returns the first t > 0 at which the body reaches the boundary, or
+ * INFINITY if it never does. Positions are assumed to be inside the box.
+ */
+
+/* Falling to 'floor' below. Always happens while g > 0 */
+static inline float time_to_floor(float y, float vy, float floor, float g)
+{
+    // g/2 t^2 - vy t - (y - floor) = 0, the other root is never positive
+    float height = y - floor > 0 ? y - floor : 0;
+    return (vy + sqrtf(vy*vy + 2*g*height)) / g;
+}
+
+/* Rising to 'ceiling' above */
+static inline float time_to_ceiling(float y, float vy, float ceiling, float g)
+{
+    float gap = ceiling - y > 0 ? ceiling - y : 0;
+    float disc = vy*vy - 2*g*gap;
+    if (vy <= 0 || disc < 0)
+        return INFINITY;
+    // Smaller root of g/2 t^2 - vy t + gap = 0, written so it does not
+    // cancel when gap is small
+    return 2*gap / (vy + sqrtf(disc));
+}
+
+/* Moving sideways to the wall at -bound or +bound */
+static inline float time_to_wall(float x, float vx, float bound)
+{
+    if (vx > 0)
+        return (bound - x) / vx;
+    if (vx < 0)
+        return (-bound - x) / vx;
+    return INFINITY;
+}
+
+/* A body in flight */
+struct Body {
+    float x;
+    float y;
+    float vx;
+    float vy;
+};
+
+#define HIT_FLOOR   1
+#define HIT_CEILING 2
+#define HIT_WALL    4
+
+/* Flies 'b' along its arc until it first reaches the box |x|, |y| <= bound
+ * or 'time' runs out, and bounces it off whatever it reached, keeping
+ * 'restitution' of the speed into that wall. Returns the time flown; 'hit'
+ * gets the HIT_ bits, 0 if time ran out first.
+ */
+static inline float ballistic_advance(Body * b, float time, float bound, float g, float restitution, int * hit)
+{
+    float t_floor = time_to_floor(b->y, b->vy, -bound, g);
+    float t_ceiling = time_to_ceiling(b->y, b->vy, bound, g);
+    float t_wall = time_to_wall(b->x, b->vx, bound);
+    float t = fminf(time, fminf(t_floor, fminf(t_ceiling, t_wall)));
+
+    b->x += b->vx*t;
+    b->y += b->vy*t - 0.5f*g*t*t;
+    b->vy -= g*t;
+    *hit = 0;
+    if (t == t_wall) {
+        b->x = b->vx > 0 ? bound : -bound;
+        b->vx = -b->vx*restitution;
+        *hit |= HIT_WALL;
+    }
+    if (t == t_floor) {
+        b->y = -bound;
+        b->vy = -b->vy*restitution;
+        *hit |= HIT_FLOOR;
+    }
+    else if (t == t_ceiling) {
+        b->y = bound;
+        b->vy = -b->vy*restitution;
+        *hit |= HIT_CEILING;
+    }
+    return t;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "collide.h"
+
+#include <math.h>
+
+#define REACH (COIN_RADIUS + PROJECTILE_RADIUS)
+
+bool coins_add(Coins * coins, float x, float y)
+{
+    if (coins->count == MAX_COINS)
+        return false;
+    coins->x[coins->count] = x;
+    coins->y[coins->count] = y;
+    coins->appear[coins->count] = 1;
+    coins->count++;
+    return true;
+}
+
+void coin_grid_init(CoinGrid * grid)
+{
+    grid->min_x = -ARENA_INNER;
+    grid->min_y = -ARENA_INNER;
+    grid->inv_cell = 1.0f / REACH;
+    grid->cols = (int)ceilf(2*ARENA_INNER / REACH);
+    grid->rows = grid->cols;
+    grid->start.assign(grid->cols*grid->rows + 1, 0);
+    grid->items.clear();
+}
+
+static int column(const CoinGrid * grid, float x)
+{
+    int c = (int)floorf((x - grid->min_x) * grid->inv_cell);
+    return c < 0 ? 0 : c >= grid->cols ? grid->cols - 1 : c;
+}
+
+static int row(const CoinGrid * grid, float y)
+{
+    int r = (int)floorf((y - grid->min_y) * grid->inv_cell);
+    return r < 0 ? 0 : r >= grid->rows ? grid->rows - 1 : r;
+}
+
+/* Counting sort of the coins by cell, O(coins + cells) */
+void coin_grid_build(CoinGrid * grid, const Coins * coins)
+{
+    int cells = grid->cols*grid->rows;
+    grid->start.assign(cells + 1, 0);
+    grid->cell_of.resize(coins->count);
+    int live = 0;
+    for (int i=0; i<coins->count; i++) {
+        grid->cell_of[i] = -1;
+        if (!coins->appear[i])
+            continue;
+        int cell = row(grid, coins->y[i])*grid->cols + column(grid, coins->x[i]);
+        grid->cell_of[i] = cell;
+        grid->start[cell + 1]++;
+        live++;
+    }
+    for (int c=0; c<cells; c++)
+        grid->start[c + 1] += grid->start[c];
+    grid->items.resize(live);
+    grid->cursor.assign(grid->start.begin(), grid->start.end() - 1);
+    for (int i=0; i<coins->count; i++)
+        if (grid->cell_of[i] >= 0)
+            grid->items[grid->cursor[grid->cell_of[i]]++] = i;
+}
+
+int coin_grid_touching(const CoinGrid * grid, const Coins * coins, float x, float y, int * found, int max_found)
+{
+    int n = 0;
+    int c = column(grid, x), r = row(grid, y);
+    for (int rr=r > 0 ? r - 1 : 0; rr<=r + 1 && rr<grid->rows; rr++)
+        for (int cc=c > 0 ? c - 1 : 0; cc<=c + 1 && cc<grid->cols; cc++) {
+            int cell = rr*grid->cols + cc;
+            for (int k=grid->start[cell]; k<grid->start[cell + 1] && n<max_found; k++) {
+                int coin = grid->items[k];
+                float dx = coins->x[coin] - x, dy = coins->y[coin] - y;
+                if (dx*dx + dy*dy <= REACH*REACH)
+                    found[n++] = coin;
+            }
+        }
+    return n;
+}
+
+int coins_collide(CoinGrid * grid, Coins * coins, const Projectiles * p)
+{
+    coin_grid_build(grid, coins);
+    if (grid->items.empty())
+        return 0;
+
+    int hits = 0;
+    int found[MAX_COINS];
+    for (int i=0; i<p->count; i++) {
+        int n = coin_grid_touching(grid, coins, p->x[i], p->y[i], found, MAX_COINS);
+        for (int k=0; k<n; k++)
+            // An earlier projectile may have taken it this step
+            if (coins->appear[found[k]]) {
+                coins->appear[found[k]] = 0;
+                hits++;
+            }
+    }
+    return hits;
+}
@@ -0,0 +1,51 @@
+#ifndef COLLIDE_H
+#define COLLIDE_H
+
+#include <vector>
+
+#include "projectiles.h"
+
+#define COIN_RADIUS 0.2f
+#define MAX_COINS 1024
+
+/* Coins to shoot at, structure of arrays like the projectiles */
+struct Coins {
+    int count;
+    float x[MAX_COINS];
+    float y[MAX_COINS];
+    int appear[MAX_COINS];
+};
+
+bool coins_add(Coins * coins, float x, float y);
+
+/* Uniform grid over the arena holding the coins still up. Cells are as wide
+ * as a coin and a projectile can reach, so anything touching a projectile
+ * is in its own cell or one of the eight around it. Positions outside the
+ * arena are clamped to the border cells, which keeps that true.
+ */
+struct CoinGrid {
+    float min_x;
+    float min_y;
+    float inv_cell;
+    int cols;
+    int rows;
+    std::vector<int> start;     // cols*rows + 1 offsets into 'items'
+    std::vector<int> items;     // coin indices grouped by cell
+    std::vector<int> cell_of;   // scratch for the build
+    std::vector<int> cursor;
+};
+
+void coin_grid_init(CoinGrid * grid);
+
+/* Sorts the coins still up into the grid */
+void coin_grid_build(CoinGrid * grid, const Coins * coins);
+
+/* Coins in a built grid that a projectile at (x, y) overlaps. Stores up to
+   'max_found' of their indices in 'found' and returns how many it stored */
+int coin_grid_touching(const CoinGrid * grid, const Coins * coins, float x, float y, int * found, int max_found);
+
+/* Rebuilds the grid from the coins still up, then knocks down every coin a
+   live projectile overlaps. Returns how many were knocked down */
+int coins_collide(CoinGrid * grid, Coins * coins, const Projectiles * p);
+
+#endif
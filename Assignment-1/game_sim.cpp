@@ -0,0 +1,116 @@
+#include "game_sim.h"
+
+void game_sim_init(GameSim * game)
+{
+    game->canon_rotation = 90;
+    game->ammo = START_AMMO;
+    game->barrage = false;
+    projectiles_init(&game->projectiles, PROJECTILE_CAPACITY);
+    game->coins.count = 0;
+    coins_add(&game->coins, 3, 3);
+    coins_add(&game->coins, 4, 1);
+    coins_add(&game->coins, 2, 4);
+    coins_add(&game->coins, 2, 2);
+    coin_grid_init(&game->coin_grid);
+    game->tick = 0;
+    game->input_seq = 0;
+    game->random = 1;
+}
+
+/* Launches a projectile from the mouth of the canon, 'angle' in degrees */
+static void fire(GameSim * game, float angle, float speed)
+{
+    Body b = canon_launch(angle, speed);
+    projectiles_spawn(&game->projectiles, b.x, b.y, b.vx, b.vy);
+}
+
+/* Uniform in [0, 1). A generator of its own rather than rand(), so a
+   replay spreads the barrage the same way on any C library */
+static float random01(GameSim * game)
+{
+    uint32_t r = game->random;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    game->random = r;
+    return (r >> 8) * (1.0f / 16777216);
+}
+
+void game_sim_apply(GameSim * game, const InputEvent * event)
+{
+    game->input_seq = event->seq;
+    if (event->type != INPUT_KEY || event->action != GAME_PRESS)
+        return;
+    switch (event->code) {
+        case GAME_KEY_UP:
+            if (game->canon_rotation < 90)
+                game->canon_rotation += 10;
+            break;
+        case GAME_KEY_DOWN:
+            if (game->canon_rotation > 0)
+                game->canon_rotation -= 10;
+            break;
+        case GAME_KEY_FIRE:
+            if (game->ammo > 0) {
+                game->ammo--;
+                fire(game, game->canon_rotation, SHOT_SPEED);
+            }
+            break;
+        case GAME_KEY_BARRAGE:
+            game->barrage = !game->barrage;
+            break;
+        default:
+            break;
+    }
+}
+
+void game_sim_step(GameSim * game)
+{
+    if (game->barrage) {
+        // A fan of shots around where the canon points
+        for (int i=0; i<BARRAGE_PER_STEP; i++) {
+            float angle = game->canon_rotation - 15 + 30*random01(game);
+            fire(game, angle, 5 + 4*random01(game));
+        }
+    }
+    projectiles_step(&game->projectiles, PROJECTILE_STEP);
+    coins_collide(&game->coin_grid, &game->coins, &game->projectiles);
+    game->tick++;
+}
+
+int game_sim_coins_up(const GameSim * game)
+{
+    int up = 0;
+    for (int i=0; i<game->coins.count; i++)
+        up += game->coins.appear[i] != 0;
+    return up;
+}
+
+/* FNV-1a */
+static uint32_t hash(uint32_t h, const void * data, size_t size)
+{
+    const unsigned char * bytes = (const unsigned char *)data;
+    for (size_t i=0; i<size; i++)
+        h = (h ^ bytes[i]) * 16777619u;
+    return h;
+}
+
+uint32_t game_sim_checksum(const GameSim * game)
+{
+    const Projectiles * p = &game->projectiles;
+    uint32_t h = 2166136261u;
+    h = hash(h, &game->tick, sizeof(game->tick));
+    h = hash(h, &game->canon_rotation, sizeof(game->canon_rotation));
+    h = hash(h, &game->ammo, sizeof(game->ammo));
+    h = hash(h, &game->barrage, sizeof(game->barrage));
+    h = hash(h, &p->count, sizeof(p->count));
+    if (p->count > 0) {
+        h = hash(h, &p->x[0], p->count*sizeof(float));
+        h = hash(h, &p->y[0], p->count*sizeof(float));
+        h = hash(h, &p->vx[0], p->count*sizeof(float));
+        h = hash(h, &p->vy[0], p->count*sizeof(float));
+        h = hash(h, &p->bounces[0], p->count*sizeof(int32_t));
+    }
+    h = hash(h, game->coins.appear, game->coins.count*sizeof(int));
+    return h;
+}
@@ -0,0 +1,58 @@
+#ifndef GAME_SIM_H
+#define GAME_SIM_H
+
+#include <stdint.h>
+
+#include "projectiles.h"
+#include "collide.h"
+#include "input_log.h"
+
+#define PROJECTILE_CAPACITY 16384
+/* Shots added every step while the barrage is on, keeps about 10k alive */
+#define BARRAGE_PER_STEP 40
+/* Speed of a shot fired with N */
+#define SHOT_SPEED 7
+#define START_AMMO 4
+
+/* Keys the game reacts to. GLFW numbers letter keys by their upper case
+   ASCII code, so these match what the window pushes into the input log */
+#define GAME_KEY_UP      'U'
+#define GAME_KEY_DOWN    'D'
+#define GAME_KEY_FIRE    'N'
+#define GAME_KEY_BARRAGE 'B'
+#define GAME_PRESS       1
+
+/* Everything the canon game simulates: the canon, the coins and the
+ * projectiles. Nothing in here touches a window or GL, so the game can run
+ * without either, and the same input gives the same game wherever it runs.
+ */
+struct GameSim {
+    float canon_rotation;       // degrees above the floor
+    int ammo;                   // single shots left
+    bool barrage;
+    Projectiles projectiles;
+    Coins coins;
+    CoinGrid coin_grid;
+    uint32_t tick;              // steps run so far
+    uint32_t input_seq;         // newest input event applied
+    uint32_t random;            // state of the barrage spread
+};
+
+/* The game as it starts: canon upright, coins up, nothing in flight */
+void game_sim_init(GameSim * game);
+
+/* Game side of an input event, applied at the start of the step it was
+   logged for */
+void game_sim_apply(GameSim * game, const InputEvent * event);
+
+/* One fixed step, after its input has been applied: fires the barrage,
+   moves the projectiles on by PROJECTILE_STEP and knocks down the coins
+   they hit */
+void game_sim_step(GameSim * game);
+
+int game_sim_coins_up(const GameSim * game);
+
+/* Hash of the whole game state, so two runs can be compared at a glance */
+uint32_t game_sim_checksum(const GameSim * game);
+
+#endif
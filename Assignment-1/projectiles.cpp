@@ -0,0 +1,163 @@
+#include "projectiles.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BOUND PROJECTILE_BOUND
+
+void projectiles_init(Projectiles * p, int capacity)
+{
+    p->count = 0;
+    p->capacity = capacity;
+    p->x.assign(capacity, 0);
+    p->y.assign(capacity, 0);
+    p->vx.assign(capacity, 0);
+    p->vy.assign(capacity, 0);
+    p->prev_x.assign(capacity, 0);
+    p->prev_y.assign(capacity, 0);
+    p->bounces.assign(capacity, 0);
+    p->alive.assign(capacity, 0);
+    p->id.assign(capacity, 0);
+    p->next_id = 0;
+}
+
+Body canon_launch(float angle, float speed)
+{
+    float c = cos(angle*M_PI/180.0f), s = sin(angle*M_PI/180.0f);
+    Body b = {CANON_X + CANON_LENGTH*c, CANON_Y + CANON_LENGTH*s, speed*c, speed*s + 5};
+    return b;
+}
+
+bool projectiles_spawn(Projectiles * p, float x, float y, float vx, float vy)
+{
+    if (p->count == p->capacity)
+        return false;
+    int i = p->count++;
+    p->x[i] = p->prev_x[i] = x;
+    p->y[i] = p->prev_y[i] = y;
+    p->vx[i] = vx;
+    p->vy[i] = vy;
+    p->bounces[i] = 0;
+    p->id[i] = p->next_id++;
+    return true;
+}
+
+/* Most hits resolved in one step. Only a projectile wedged in a corner
+   with almost no speed gets near it */
+#define MAX_HITS_PER_STEP 16
+
+/* One projectile, exactly: flies along its parabola to the first wall it
+ * reaches, bounces there, and carries on for the rest of the step. Used for
+ * the lanes the vector loop cannot settle and for the leftover entries.
+ */
+static void step_one(Projectiles * p, int i, float dt)
+{
+    Body b = {p->x[i], p->y[i], p->vx[i], p->vy[i]};
+    p->prev_x[i] = b.x;
+    p->prev_y[i] = b.y;
+
+    float left = dt;
+    for (int hits=0; hits<MAX_HITS_PER_STEP; hits++) {
+        int hit;
+        left -= ballistic_advance(&b, left, BOUND, PROJECTILE_GRAVITY, PROJECTILE_RESTITUTION, &hit);
+        if (hit & HIT_FLOOR)
+            p->bounces[i]++;
+        if (left <= 0 || p->bounces[i] >= PROJECTILE_MAX_BOUNCES)
+            break;
+    }
+    // Rounding can leave it a hair outside after many hits
+    p->x[i] = fmaxf(-BOUND, fminf(BOUND, b.x));
+    p->y[i] = fmaxf(-BOUND, fminf(BOUND, b.y));
+    p->vx[i] = b.vx;
+    p->vy[i] = b.vy;
+    p->alive[i] = p->bounces[i] < PROJECTILE_MAX_BOUNCES ? -1 : 0;
+}
+
+#ifdef __SSE2__
+/* Free flight for four projectiles at a time. A lane can only be moved to
+ * the end of the step this way if it stays inside the box the whole time:
+ * its end point is inside, and it does not pass the top of its arc above
+ * the ceiling mid step (x is linear and the arc is highest in the middle,
+ * so nothing else can leave and come back). Groups with a lane that
+ * touches a wall go through step_one instead.
+ */
+static int step_sse2(Projectiles * p, float dt)
+{
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128 gdt = _mm_set1_ps(PROJECTILE_GRAVITY*dt);
+    const __m128 drop = _mm_set1_ps(0.5f*PROJECTILE_GRAVITY*dt*dt);
+    const __m128 inv_2g = _mm_set1_ps(0.5f/PROJECTILE_GRAVITY);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 hi = _mm_set1_ps(BOUND);
+    const __m128 lo = _mm_set1_ps(-BOUND);
+
+    int i = 0;
+    for (; i + 4 <= p->count; i += 4) {
+        __m128 x = _mm_loadu_ps(&p->x[i]);
+        __m128 y = _mm_loadu_ps(&p->y[i]);
+        __m128 vx = _mm_loadu_ps(&p->vx[i]);
+        __m128 vy = _mm_loadu_ps(&p->vy[i]);
+
+        __m128 nx = _mm_add_ps(x, _mm_mul_ps(vx, vdt));
+        __m128 ny = _mm_sub_ps(_mm_add_ps(y, _mm_mul_ps(vy, vdt)), drop);
+        __m128 nvy = _mm_sub_ps(vy, gdt);
+
+        __m128 out = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(nx, lo), _mm_cmpgt_ps(nx, hi)),
+                               _mm_or_ps(_mm_cmplt_ps(ny, lo), _mm_cmpgt_ps(ny, hi)));
+        // Top of the arc inside the step: vy > 0 and vy - g*dt < 0
+        __m128 apex_inside = _mm_and_ps(_mm_cmpgt_ps(vy, zero), _mm_cmplt_ps(nvy, zero));
+        __m128 apex_y = _mm_add_ps(y, _mm_mul_ps(_mm_mul_ps(vy, vy), inv_2g));
+        out = _mm_or_ps(out, _mm_and_ps(apex_inside, _mm_cmpgt_ps(apex_y, hi)));
+
+        if (_mm_movemask_ps(out)) {
+            for (int k=0; k<4; k++)
+                step_one(p, i + k, dt);
+            continue;
+        }
+        _mm_storeu_ps(&p->prev_x[i], x);
+        _mm_storeu_ps(&p->prev_y[i], y);
+        _mm_storeu_ps(&p->x[i], nx);
+        _mm_storeu_ps(&p->y[i], ny);
+        _mm_storeu_ps(&p->vy[i], nvy);
+        // Nothing bounced, so the bounce counts and vx stay as they are
+        _mm_storeu_si128((__m128i *)&p->alive[i],
+            _mm_cmplt_epi32(_mm_loadu_si128((const __m128i *)&p->bounces[i]),
+                            _mm_set1_epi32(PROJECTILE_MAX_BOUNCES)));
+    }
+    return i;
+}
+#endif
+
+/* Moves the last live projectile into every dead slot */
+static void compact(Projectiles * p)
+{
+    int i = 0;
+    while (i < p->count) {
+        if (p->alive[i]) {
+            i++;
+            continue;
+        }
+        int last = --p->count;
+        p->x[i] = p->x[last];
+        p->y[i] = p->y[last];
+        p->vx[i] = p->vx[last];
+        p->vy[i] = p->vy[last];
+        p->prev_x[i] = p->prev_x[last];
+        p->prev_y[i] = p->prev_y[last];
+        p->bounces[i] = p->bounces[last];
+        p->alive[i] = p->alive[last];
+        p->id[i] = p->id[last];
+    }
+}
+
+void projectiles_step(Projectiles * p, float dt)
+{
+    int i = 0;
+#ifdef __SSE2__
+    i = step_sse2(p, dt);
+#endif
+    for (; i < p->count; i++)
+        step_one(p, i, dt);
+    compact(p);
+}
@@ -0,0 +1,61 @@
+#ifndef PROJECTILES_H
+#define PROJECTILES_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "ballistics.h"
+
+/* Arena the projectiles move in, in world units. The walls drawn by draw()
+   are centred on +-4.75 and 0.5 thick, so their inner faces are at +-4.5 */
+#define ARENA_INNER 4.5f
+#define PROJECTILE_RADIUS 0.2f
+#define PROJECTILE_GRAVITY 10.0f
+#define PROJECTILE_RESTITUTION 0.5f     // speed kept by a bounce
+#define PROJECTILE_MAX_BOUNCES 5        // floor bounces before it is removed
+#define PROJECTILE_STEP 0.01f           // game time moved on by a simulation step
+/* Furthest a projectile's centre gets from the middle of the arena */
+#define PROJECTILE_BOUND (ARENA_INNER - PROJECTILE_RADIUS)
+
+/* The canon sits in the bottom left corner, shots leave from its mouth */
+#define CANON_X -4.0f
+#define CANON_Y -4.0f
+#define CANON_LENGTH 1.2f
+
+/* Pool of projectiles in structure of arrays layout, so the update runs
+ * four at a time. Live projectiles are always the first 'count' entries;
+ * the update moves the last live one into every slot that dies.
+ */
+struct Projectiles {
+    int count;
+    int capacity;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+    std::vector<float> prev_x;      // position before the last step, for drawing
+    std::vector<float> prev_y;
+    std::vector<int32_t> bounces;
+    std::vector<int32_t> alive;     // written by the update, all bits set while live
+    std::vector<int32_t> id;        // order it was spawned in since init
+    int next_id;
+};
+
+void projectiles_init(Projectiles * p, int capacity);
+
+/* A shot leaving the canon at 'angle' degrees and 'speed', with the extra
+   upward push the single bullet always had */
+Body canon_launch(float angle, float speed);
+
+/* False when the pool is full */
+bool projectiles_spawn(Projectiles * p, float x, float y, float vx, float vy);
+
+/* Moves every projectile on by 'dt' along its exact arc. Hits on the floor,
+ * ceiling and side walls are found by their time of impact, so a fast
+ * projectile or a long step cannot pass through a wall, and several
+ * bounces can happen in one step. Projectiles that have bounced out are
+ * dropped at the end.
+ */
+void projectiles_step(Projectiles * p, float dt);
+
+#endif
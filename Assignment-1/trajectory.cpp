@@ -0,0 +1,50 @@
+#include "trajectory.h"
+
+void trajectory_compute(Trajectory * t, Body launch)
+{
+    Body b = launch;
+    float time = 0;
+    int bounces = 0;
+
+    t->num_segments = 0;
+    while (t->num_segments < TRAJECTORY_MAX_SEGMENTS) {
+        t->start[t->num_segments] = time;
+        t->body[t->num_segments] = b;
+        t->num_segments++;
+
+        int hit;
+        time += ballistic_advance(&b, INFINITY, PROJECTILE_BOUND, PROJECTILE_GRAVITY, PROJECTILE_RESTITUTION, &hit);
+        if ((hit & HIT_FLOOR) && ++bounces >= PROJECTILE_MAX_BOUNCES)
+            break;
+    }
+    t->end_time = time;
+}
+
+void trajectory_point(const Trajectory * t, float time, float * x, float * y)
+{
+    time = fmaxf(0, fminf(time, t->end_time));
+    // Last segment starting at or before 'time'
+    int lo = 0, hi = t->num_segments - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (t->start[mid] <= time)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    const Body * b = &t->body[lo];
+    float dt = time - t->start[lo];
+    *x = b->x + b->vx*dt;
+    *y = b->y + b->vy*dt - 0.5f*PROJECTILE_GRAVITY*dt*dt;
+}
+
+const Trajectory * trajectory_for_shot(TrajectoryCache * cache, float angle, float speed)
+{
+    std::pair<int, int> key(lroundf(angle*100), lroundf(speed*100));
+    TrajectoryCache::iterator found = cache->find(key);
+    if (found != cache->end())
+        return &found->second;
+    Trajectory * t = &(*cache)[key];
+    trajectory_compute(t, canon_launch(angle, speed));
+    return t;
+}
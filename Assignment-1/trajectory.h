@@ -0,0 +1,37 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <map>
+#include <utility>
+
+#include "projectiles.h"
+
+/* Enough for the floor bounces plus the wall hits in between */
+#define TRAJECTORY_MAX_SEGMENTS 32
+
+/* Whole flight of one shot, worked out in closed form. The path is a chain
+ * of parabolas joined at the bounce points: segment i starts at time
+ * start[i] in state body[i], right after a bounce (or the launch). The shot
+ * is gone at end_time, after its last floor bounce.
+ */
+struct Trajectory {
+    int num_segments;
+    float start[TRAJECTORY_MAX_SEGMENTS];
+    Body body[TRAJECTORY_MAX_SEGMENTS];
+    float end_time;
+};
+
+/* Follows 'launch' through the same bounces projectiles_step makes */
+void trajectory_compute(Trajectory * t, Body launch);
+
+/* Position 'time' after the launch, clamped to [0, end_time] */
+void trajectory_point(const Trajectory * t, float time, float * x, float * y);
+
+/* Trajectories already worked out, keyed on angle and speed in hundredths.
+   The canon only turns in steps, so there are few of them */
+typedef std::map<std::pair<int, int>, Trajectory> TrajectoryCache;
+
+/* The trajectory of a shot fired from the canon, computed on first use */
+const Trajectory * trajectory_for_shot(TrajectoryCache * cache, float angle, float speed);
+
+#endif
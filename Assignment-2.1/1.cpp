@@ -1,7 +1,12 @@
 #include "includes.h"
+#include "texture_array.h"
+#include "level.h"
+#include "occupancy.h"
 
 using namespace std;
-int arr[1000][3],obs[100][3];
+vector<LevelPoint> obstacles;
+Level level;
+Occupancy occupancy;
 struct VAO {
     GLuint VertexArrayID;
     GLuint VertexBuffer;
@@ -21,6 +26,8 @@ struct GLMatrices {
 } Matrices;
 
 GLuint programID;
+GLuint arrayProgramID, ArrayMatrixID;
+AssetPack assets;
 
 /* Function to load Shaders - Use it as it is */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
@@ -29,9 +36,13 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-	// Read the Vertex Shader code from the file
+	// Read the Vertex Shader code from the asset pack, or from the file
+	AssetView VertexShaderView;
+	bool VertexInPack = asset_pack_find(&assets, vertex_file_path, &VertexShaderView);
 	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
+	std::ifstream VertexShaderStream;
+	if(!VertexInPack)
+		VertexShaderStream.open(vertex_file_path, std::ios::in);
 	if(VertexShaderStream.is_open())
 	{
 		std::string Line = "";
@@ -40,9 +51,13 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 		VertexShaderStream.close();
 	}
 
-	// Read the Fragment Shader code from the file
+	// Read the Fragment Shader code from the asset pack, or from the file
+	AssetView FragmentShaderView;
+	bool FragmentInPack = asset_pack_find(&assets, fragment_file_path, &FragmentShaderView);
 	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
+	std::ifstream FragmentShaderStream;
+	if(!FragmentInPack)
+		FragmentShaderStream.open(fragment_file_path, std::ios::in);
 	if(FragmentShaderStream.is_open()){
 		std::string Line = "";
 		while(getline(FragmentShaderStream, Line))
@@ -56,7 +71,12 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Compile Vertex Shader
 	printf("Compiling shader : %s\n", vertex_file_path);
 	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
+	GLint VertexSourceLength = VertexShaderCode.size();
+	if(VertexInPack) {
+		VertexSourcePointer = (char const *)VertexShaderView.data;
+		VertexSourceLength = VertexShaderView.size;
+	}
+	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , &VertexSourceLength);
 	glCompileShader(VertexShaderID);
 
 	// Check Vertex Shader
@@ -69,7 +89,12 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Compile Fragment Shader
 	printf("Compiling shader : %s\n", fragment_file_path);
 	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+	GLint FragmentSourceLength = FragmentShaderCode.size();
+	if(FragmentInPack) {
+		FragmentSourcePointer = (char const *)FragmentShaderView.data;
+		FragmentSourceLength = FragmentShaderView.size;
+	}
+	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , &FragmentSourceLength);
 	glCompileShader(FragmentShaderID);
 
 	// Check Fragment Shader
@@ -151,6 +176,30 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
     return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
 }
 
+/* Generate VAO, VBOs and return VAO handle - attribute 1 holds (u, v, layer) into a texture array */
+struct VAO* createTexturedObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* texcoord_buffer_data, GLenum fill_mode=GL_FILL)
+{
+    struct VAO* vao = new struct VAO;
+    vao->PrimitiveMode = primitive_mode;
+    vao->NumVertices = numVertices;
+    vao->FillMode = fill_mode;
+
+    glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
+    glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
+    glGenBuffers (1, &(vao->ColorBuffer));  // VBO - texture coordinates
+
+    glBindVertexArray (vao->VertexArrayID);
+    glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer);
+    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer);
+    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), texcoord_buffer_data, GL_STATIC_DRAW);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    return vao;
+}
+
 /* Render the VBOs handled by VAO */
 void draw3DObject (struct VAO* vao)
 {
@@ -200,34 +249,15 @@ void draw3DObject (struct VAO* vao)
 /**************************
  * Customizable functions *
  **************************/
+/* Builds the cell lookup that search() and fallorcollide() use */
 void missing()
 {
-  arr[0][0] = 2;
-  arr[0][1] = -2;
-  arr[1][0] = 4;
-  arr[1][1] = 6;
-  arr[2][0] = -8;
-  arr[2][1] = -4;
-  arr[3][0] = 6;
-  arr[3][1]=10;
-  arr[4][0] = -4;
-  arr[4][1]= -8;
-  arr[5][0]= -2;
-  arr[5][1] = 6;
-  arr[6][0] = -6;
-  arr[6][1] =2;
-  arr[7][0] =-2;
-  arr[7][1] = 8; 
+  occupancy_build(&occupancy, &level);
 }
 
 int search(int x,int z)
 {
-  for(int i=0;i<8;i++)
-  {
-    if(arr[i][0]==x and arr[i][1]==z)
-      return 1;
-  }
-  return 0;
+  return (occupancy_at(&occupancy, x, z) & OCC_HOLE) != 0;
 }
 int pos_x;
 int pos_z;
@@ -259,8 +289,8 @@ void keyboardUp (unsigned char key, int x, int y)
           if(appear == 0)
           {
             appear=1;
-            pos_x = -10;
-            pos_z = -10;
+            pos_x = level.header->spawn.x;
+            pos_z = level.header->spawn.z;
           }
           break;
         }
@@ -359,39 +389,34 @@ void mouseMotion (int x, int y)
 {
 }
 
+/* Collects the obstacle positions by walking the level's tile runs */
 void obstacle()
 {
-  obs[0][0] = 2;
-  obs[0][1] = 2;
-  obs[1][0] = 8;
-  obs[1][1] = -2;
-  obs[2][0] = 2;
-  obs[2][1] = -4;
-  obs[3][0] = -6;
-  obs[3][1] = -4;
-  obs[4][0] = -8;
-  obs[4][1] =  8;
-  obs[5][0] = -2;
-  obs[5][1] = 8;
-  obs[6][0] = 6;
-  obs[6][1] = -8;
+  const LevelHeader* h = level.header;
+  const TileRuns* runs = &level.tiles;
+  obstacles.clear();
+  for(uint32_t cz=0;cz<h->depth;cz++)
+  {
+    TileRowWalk walk;
+    TileSpan span;
+    tile_row_begin(&walk, runs, 0, cz);
+    while(tile_row_next(&walk, &span))
+    {
+      if(!(span.tile & TILE_OBSTACLE))
+        continue;
+      for(uint32_t cx=span.start;cx<span.end;cx++)
+      {
+        LevelPoint p = {h->origin_x + (int)cx*h->cell_size, h->origin_z + (int)cz*h->cell_size};
+        obstacles.push_back(p);
+      }
+    }
+  }
 }
 
+/* Standing over a hole, inside an obstacle or off the edge of the level */
 int fallorcollide()
 {
-  for(int i=0;i<=9;i++)
-  {
-    if(pos_x==arr[i][0] and pos_z==arr[i][1])
-      return 1;
-  }
-  for(int i=0;i<6;i++)
-  {
-    if(pos_x==obs[i][0] and pos_z==obs[i][1])
-      return 1;
-  }
-  if(pos_x<=-12 or pos_x>=12 or pos_z<=-12 or pos_z >=12)
-    return 1;
-  return 0;
+  return occupancy_at(&occupancy, pos_x, pos_z) != OCC_FLOOR;
 }
 
 /* Executed when window is resized to 'width' and 'height' */
@@ -574,10 +599,10 @@ void createTriangle ()
   triangle = create3DObject(GL_TRIANGLES,36, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
-void createRectangle ()
-{
-  // GL3 accepts only Triangles. Quads are not supported static
-  const GLfloat vertex_buffer_data [] = {
+// Unit cube and where each of its vertices sits in the texture, shared by
+// createRectangle and createTiledFloor
+// GL3 accepts only Triangles. Quads are not supported
+static const GLfloat cube_vertex_data [] = {
     -1.0f,-1.0f,-1.0f, // triangle 1 : begin
 
      -1.0f,-1.0f, 1.0f,
@@ -651,7 +676,7 @@ void createRectangle ()
      1.0f,-1.0f, 1.0f
   };
 
-  static const GLfloat color_buffer_data[] ={
+static const GLfloat cube_uv_data[] ={
     0.000059f, 1.0f-0.000004f,
     0.000103f, 1.0f-0.336048f,
     0.335973f, 1.0f-0.335903f,
@@ -689,7 +714,71 @@ void createRectangle ()
     1.000004f, 1.0f-0.671847f,
      0.667979f, 1.0f-0.335851f
   };
-  rectangle = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
+
+void createRectangle ()
+{
+  rectangle = create3DObject(GL_TRIANGLES, 36, cube_vertex_data, cube_uv_data, GL_FILL);
+}
+
+VAO *floor_tiles;
+GLuint tileTextures;
+int tile_layers = 1;
+
+/* Texture array layer for the floor tile at (x, z) : the level's material
+   when it names one, otherwise a scatter of the available tiles */
+int tileLayer(int x, int z)
+{
+  int cx, cz;
+  if(level_cell(&level, x, z, &cx, &cz))
+  {
+    int material = tile_runs_at(&level.tiles, cx, cz) >> TILE_MATERIAL_SHIFT;
+    if(material)
+      return material % tile_layers;
+  }
+  unsigned int h = (unsigned int)(x*73856093) ^ (unsigned int)(z*19349663);
+  return h % tile_layers;
+}
+
+/* Height of the tiles the player walks on, and the cubes stacked under
+   each one counting the top one */
+#define FLOOR_TOP 2
+#define FLOOR_LAYERS 3
+
+/* Builds every floor cube the level needs into one mesh whose third texture
+   coordinate picks the tile's layer, so the whole floor is one draw call */
+void createTiledFloor ()
+{
+  const LevelHeader* h = level.header;
+  std::vector<uint8_t> row(h->width);
+  std::vector<GLfloat> vertices, coords;
+  size_t cubes = (size_t)h->width*h->depth*FLOOR_LAYERS;
+  vertices.reserve(cubes*36*3);
+  coords.reserve(cubes*36*3);
+  for(uint32_t cz=0;cz<h->depth;cz++)
+  {
+    tile_runs_decode_row(&level.tiles, cz, &row[0]);
+    int z = h->origin_z + (int)cz*h->cell_size;
+    for(uint32_t cx=0;cx<h->width;cx++)
+    {
+      int x = h->origin_x + (int)cx*h->cell_size;
+      GLfloat layer = tileLayer(x, z);
+      // A hole only takes away the top cube, the column under it stays
+      for(int j=(row[cx] & TILE_HOLE) ? 1 : 0;j<FLOOR_LAYERS;j++)
+      {
+        int y = FLOOR_TOP - 2*j;
+        for(int v=0;v<36;v++)
+        {
+          vertices.push_back(cube_vertex_data[3*v] + x);
+          vertices.push_back(cube_vertex_data[3*v+1] + y);
+          vertices.push_back(cube_vertex_data[3*v+2] + z);
+          coords.push_back(cube_uv_data[2*v]);
+          coords.push_back(cube_uv_data[2*v+1]);
+          coords.push_back(layer);
+        }
+      }
+    }
+  }
+  floor_tiles = createTexturedObject(GL_TRIANGLES, vertices.size()/3, &vertices[0], &coords[0]);
 }
 
 
@@ -744,100 +833,19 @@ void draw ()
   glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
   draw3DObject(rectangle);
 
-  for(int k=0;k<6;k++)
-  {
-    for(int i=0;i<6;i++)
-    {
-      for(int j=0;j<2;j++)
-      {
-        //glm::mat4 scalecube = glm::scale(glm::vec3(0.25f,0.25f,0.25f));
-        Matrices.model = glm::mat4(1.0f);
-        //glm::mat4 translatecube3 = glm::translate(glm::vec3(0.5f*i,0.5f*j,0.5f*k));
-        glm::mat4 translatecube3 = glm::translate(glm::vec3(2*i,2*j,2*k));
-        //Matrices.model*=(translatecube3*scalecube);
-        Matrices.model*=(translatecube3);
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        if(search(2*i,2*k)==1 and j==1)
-        {
-        }
-        else
-          draw3DObject(triangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-j,0)))*scalecube);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-4*j,0)))*scalecube);
-        Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-4*j,0))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(triangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-j,-k)))*scalecube);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-4*j,-4*k)))*scalecube);
-        Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-4*j,-4*k))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(triangle);
-
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,0,-k)))*scalecube);
-        Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,0,-4*k))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        if(search(2*i,-2*k) and j==1)
-        {
+  // The whole floor : one texture bind and one draw call
+  glUseProgram (arrayProgramID);
+  MVP = VP;
+  glUniformMatrix4fv(ArrayMatrixID,1,GL_FALSE,&MVP[0][0]);
+  glActiveTexture (GL_TEXTURE0);
+  glBindTexture (GL_TEXTURE_2D_ARRAY, tileTextures);
+  draw3DObject(floor_tiles);
+  glUseProgram (programID);
 
-        }
-        else
-          draw3DObject(triangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //glm::mat4 translatecube4 = glm::translate(glm::vec3(-0.5f*i,0.5f*j,-0.5f*k));
-        glm::mat4 translatecube4 = glm::translate(glm::vec3(-2*i,2*j,-2*k));
-        //Matrices.model*=(translatecube4*scalecube);
-        Matrices.model*=(translatecube4);
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        if(search(-2*i,-2*k) and j==1)
-        {
-        }
-        else
-          draw3DObject(triangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,-j,0)))*scalecube);
-        Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,-4*j,0))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(triangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,-j,k)))*scalecube);
-        Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,-4*j,4*k))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(triangle);
-
-        
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,0,k)))*scalecube);
-        Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,0,4*k))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        if(search(-2*i,2*k) and j==1)
-        {
-        }
-        else
-          draw3DObject(triangle);
-      }
-    }
-  }
-  for(int i=0;i<7;i++)
+  for(size_t i=0;i<obstacles.size();i++)
   {
     Matrices.model = glm::mat4(1.0f);
-    Matrices.model*=(glm::translate(glm::vec3(obs[i][0],4,obs[i][1])));
+    Matrices.model*=(glm::translate(glm::vec3(obstacles[i].x,4,obstacles[i].z)));
     MVP = VP*Matrices.model;
     glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
     draw3DObject(triangle);
@@ -852,8 +860,8 @@ void draw ()
   }
   if(fallorcollide())
   {
-    pos_x=-10;
-    pos_z=-10;
+    pos_x=level.header->spawn.x;
+    pos_z=level.header->spawn.z;
     lives--;
   }
   glutSwapBuffers ();
@@ -946,6 +954,24 @@ void initGL (int width, int height)
 	// Get a handle for our "MVP" uniform
 	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
 
+	// Tile materials : the rock sheet cut into 4x2 tiles, one array layer each
+	BMPImage sheet;
+	TextureArrayBuilder tiles;
+	texture_array_init(&tiles, 0, 0);
+	if(readBMP(&assets, "rocky_texture_9_by_zeroempires-d66hd6j.bmp", &sheet))
+	{
+		texture_array_init(&tiles, sheet.width/4, sheet.height/2);
+		texture_array_add_sheet(&tiles, sheet);
+		if(tiles.layers > 0)
+			tile_layers = tiles.layers;
+	}
+	tileTextures = texture_array_upload(&tiles);
+
+	arrayProgramID = LoadShaders( "Sample_GL_array.vert", "Sample_GL_array.frag" );
+	ArrayMatrixID = glGetUniformLocation(arrayProgramID, "MVP");
+	glUseProgram (arrayProgramID);
+	glUniform1i(glGetUniformLocation(arrayProgramID, "tiles"), 0);
+	createTiledFloor ();
 
 	reshapeWindow (width, height);
 
@@ -970,6 +996,11 @@ int main (int argc, char** argv)
 {
 	int width = 1366;
 	int height = 768;
+  // Shaders come from assets.pak when it is present, loose files otherwise
+  asset_pack_open(&assets, "assets.pak");
+  // Hole and obstacle layout, mapped and used in place
+  if(!level_open_asset(&level, &assets, "level.lvl"))
+    return 1;
   missing();
   obstacle();
   if(lives>=0)
@@ -979,7 +1010,6 @@ int main (int argc, char** argv)
     addGLUTMenus ();
 
 	initGL (width, height);
-  GLuint Texture = loadBMP_custom("rocky_texture_9_by_zeroempires-d66hd6j.bmp");
     glutMainLoop ();
   }
 
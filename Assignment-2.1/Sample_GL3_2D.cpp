@@ -4,6 +4,7 @@
 #include <vector>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
 
 #include <GL/glew.h>
 #include <GL/glu.h>
@@ -14,8 +15,23 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "asset_pack.h"
+#include "level.h"
+#include "occupancy.h"
+#include "level_stream.h"
+#include "input_log.h"
+#include "frame_sched.h"
+#include "triple_buffer.h"
+#include "sim_thread.h"
+#include "latency.h"
+#include "offscreen.h"
+#include "capture.h"
+
 using namespace std;
-int arr[1000][3],obs[100][3];
+Level level;
+Occupancy occupancy;
+LevelStream stream;
+LevelStreamConfig stream_config;
 struct VAO {
     GLuint VertexArrayID;
     GLuint VertexBuffer;
@@ -35,6 +51,18 @@ struct GLMatrices {
 } Matrices;
 
 GLuint programID;
+AssetPack assets;
+InputLog input_log;
+FrameSched frame_sched;
+/* --capture writes every frame drawn to a file, see capture.h */
+Capture capture;
+bool capturing = false;
+uint32_t sim_tick=0;     // simulation steps run so far
+
+/* Real time per simulation step */
+#define SIM_STEP (1.0/60)
+/* Longest frame the simulation catches up on */
+#define MAX_FRAME_TIME 0.25
 
 /* Function to load Shaders - Use it as it is */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
@@ -43,9 +71,13 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-	// Read the Vertex Shader code from the file
+	// Read the Vertex Shader code from the asset pack, or from the file
+	AssetView VertexShaderView;
+	bool VertexInPack = asset_pack_find(&assets, vertex_file_path, &VertexShaderView);
 	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
+	std::ifstream VertexShaderStream;
+	if(!VertexInPack)
+		VertexShaderStream.open(vertex_file_path, std::ios::in);
 	if(VertexShaderStream.is_open())
 	{
 		std::string Line = "";
@@ -54,9 +86,13 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 		VertexShaderStream.close();
 	}
 
-	// Read the Fragment Shader code from the file
+	// Read the Fragment Shader code from the asset pack, or from the file
+	AssetView FragmentShaderView;
+	bool FragmentInPack = asset_pack_find(&assets, fragment_file_path, &FragmentShaderView);
 	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
+	std::ifstream FragmentShaderStream;
+	if(!FragmentInPack)
+		FragmentShaderStream.open(fragment_file_path, std::ios::in);
 	if(FragmentShaderStream.is_open()){
 		std::string Line = "";
 		while(getline(FragmentShaderStream, Line))
@@ -70,7 +106,12 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Compile Vertex Shader
 	printf("Compiling shader : %s\n", vertex_file_path);
 	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
+	GLint VertexSourceLength = VertexShaderCode.size();
+	if(VertexInPack) {
+		VertexSourcePointer = (char const *)VertexShaderView.data;
+		VertexSourceLength = VertexShaderView.size;
+	}
+	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , &VertexSourceLength);
 	glCompileShader(VertexShaderID);
 
 	// Check Vertex Shader
@@ -83,7 +124,12 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Compile Fragment Shader
 	printf("Compiling shader : %s\n", fragment_file_path);
 	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+	GLint FragmentSourceLength = FragmentShaderCode.size();
+	if(FragmentInPack) {
+		FragmentSourcePointer = (char const *)FragmentShaderView.data;
+		FragmentSourceLength = FragmentShaderView.size;
+	}
+	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , &FragmentSourceLength);
 	glCompileShader(FragmentShaderID);
 
 	// Check Fragment Shader
@@ -191,34 +237,15 @@ void draw3DObject (struct VAO* vao)
 /**************************
  * Customizable functions *
  **************************/
+/* Builds the cell lookup that search() and fallorcollide() use */
 void missing()
 {
-  arr[0][0] = 2;
-  arr[0][1] = -2;
-  arr[1][0] = 4;
-  arr[1][1] = 6;
-  arr[2][0] = -8;
-  arr[2][1] = -4;
-  arr[3][0] = 6;
-  arr[3][1]=10;
-  arr[4][0] = -4;
-  arr[4][1]= -8;
-  arr[5][0]= -2;
-  arr[5][1] = 6;
-  arr[6][0] = -6;
-  arr[6][1] =2;
-  arr[7][0] =-2;
-  arr[7][1] = 8; 
+  occupancy_build(&occupancy, &level);
 }
 
 int search(int x,int z)
 {
-  for(int i=0;i<8;i++)
-  {
-    if(arr[i][0]==x and arr[i][1]==z)
-      return 1;
-  }
-  return 0;
+  return (occupancy_at(&occupancy, x, z) & OCC_HOLE) != 0;
 }
 int pos_x;
 int pos_z;
@@ -245,8 +272,22 @@ int camera_y=10;
 int camera_z=0;
 glm::vec3 eye (-15,10,0);
 glm::vec3 target (0, 0, 0);
-/* Executed when a regular key is released */
-void keyboardUp (unsigned char key, int x, int y)
+/* Walking off the edge of the level costs a life, holes and obstacles are
+   left to fallorcollide() */
+void move (int dx, int dz)
+{
+  pos_x+=dx;
+  pos_z+=dz;
+  if(occupancy_at(&occupancy, pos_x, pos_z) & OCC_OUTSIDE)
+  {
+    appear=0;
+    lives--;
+  }
+}
+
+/* Game side of a key release, run at the start of the simulation step it
+   was logged for */
+void applyKeyUp (unsigned char key)
 {
     switch (key) {
         case 'n':
@@ -254,52 +295,23 @@ void keyboardUp (unsigned char key, int x, int y)
           if(appear == 0)
           {
             appear=1;
-            pos_x = -10;
-            pos_z = -10;
+            pos_x = level.header->spawn.x;
+            pos_z = level.header->spawn.z;
           }
           break;
         }
         case 'd':
-        {
-           pos_z+=2;
-          if(pos_z>10)
-          {
-            appear=0;
-            lives--;
-          } 
-         
+          move(0, 2);
           break;
-        }
         case 'a':
-        {
-          pos_z-=2;
-          if(pos_z<-10)
-          {
-            appear=0;
-            lives--;
-          }
+          move(0, -2);
           break;
-        }
         case 'w':
-        {
-          pos_x+=2;
-          if(pos_x>10 or pos_x<-10)
-          {
-            appear=0;
-            lives--;
-          }
+          move(2, 0);
           break;
-        }
         case 's':
-        {
-          pos_x-=2;
-          if(pos_x<-10)
-          {
-            appear=0;
-            lives--;
-          }
+          move(-2, 0);
           break;
-        }
         case 'p':
         {
           flag=2;
@@ -374,10 +386,8 @@ void keyboardSpecialUp (int key, int x, int y)
 {
 }
 
-/* Executed when a mouse button 'button' is put into state 'state'
- at screen position ('x', 'y')
- */
-void mouseClick (int button, int state, int x, int y)
+/* Game side of a mouse button 'button' put into state 'state' */
+void applyMouseClick (int button, int state)
 {
     switch (button) {
         case GLUT_LEFT_BUTTON:
@@ -405,50 +415,57 @@ void mouseClick (int button, int state, int x, int y)
 }
 
 
-/* Executed when the mouse moves to position ('x', 'y') */
-void mouseMotion (int x, int y)
+/* Executed when a regular key is released. Goes through the input log so a
+   session can be recorded and replayed */
+void keyboardUp (unsigned char key, int x, int y)
+{
+    input_log_push(&input_log, INPUT_KEY, key, GLUT_UP, 0, x, y);
+}
+
+/* Executed when a mouse button 'button' is put into state 'state'
+ at screen position ('x', 'y')
+ */
+void mouseClick (int button, int state, int x, int y)
 {
+    input_log_push(&input_log, INPUT_MOUSE, button, state, 0, x, y);
 }
 
-void obstacle()
+/* Runs a logged event through the game */
+void applyInput (const InputEvent* event)
+{
+    switch (event->type) {
+        case INPUT_KEY:
+            applyKeyUp(event->code);
+            break;
+        case INPUT_MOUSE:
+            applyMouseClick(event->code, event->action);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Executed when the mouse moves to position ('x', 'y') */
+void mouseMotion (int x, int y)
 {
-  obs[0][0] = 2;
-  obs[0][1] = 2;
-  obs[1][0] = 8;
-  obs[1][1] = -2;
-  obs[2][0] = 2;
-  obs[2][1] = -4;
-  obs[3][0] = -6;
-  obs[3][1] = -4;
-  obs[4][0] = -8;
-  obs[4][1] =  8;
-  obs[5][0] = -2;
-  obs[5][1] = 8;
-  obs[6][0] = 6;
-  obs[6][1] = -8;
 }
 
+/* Standing over a hole, inside an obstacle or off the edge of the level */
 int fallorcollide()
 {
-  for(int i=0;i<=9;i++)
-  {
-    if(pos_x==arr[i][0] and pos_z==arr[i][1])
-      return 1;
-  }
-  for(int i=0;i<6;i++)
-  {
-    if(pos_x==obs[i][0] and pos_z==obs[i][1])
-      return 1;
-  }
-  if(pos_x<=-12 or pos_x>=12 or pos_z<=-12 or pos_z >=12)
-    return 1;
-  return 0;
+  return occupancy_at(&occupancy, pos_x, pos_z) != OCC_FLOOR;
 }
 
 /* Executed when window is resized to 'width' and 'height' */
 /* Modify the bounds of the screen here in glm::ortho or Field of View in glm::Perspective */
 void reshapeWindow (int width, int height)
 {
+    // Frames are read at the size the capture started with, so the window
+    // goes back to it
+    if (capturing && (width != capture.width || height != capture.height)) {
+        glutReshapeWindow (capture.width, capture.height);
+        return;
+    }
 	GLfloat fov = 90.0f;
 
 	// sets the viewport of openGL renderer
@@ -459,6 +476,7 @@ void reshapeWindow (int width, int height)
 
     // Perspective projection for 3D views
     Matrices.projection = glm::perspective (fov, (GLfloat) width / (GLfloat) height, 0.1f, 500.0f);
+    frame_sched_request(&frame_sched);
 
     // Ortho projection for 2D views
     //Matrices.projection = glm::ortho(-4.0f, 4.0f, -4.0f, 4.0f, 0.1f, 500.0f);
@@ -709,6 +727,10 @@ void createRectangle ()
     color_buffer_data[i] = 1;
   // create3DObject creates and returns a handle to a VAO that can be used later
   rectangle = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
+
+  // The streamed floor is built out of copies of this cube
+  stream_config.cube_vertices.assign(vertex_buffer_data, vertex_buffer_data + 108);
+  stream_config.cube_colors.assign(color_buffer_data, color_buffer_data + 108);
 }
 
 
@@ -717,42 +739,212 @@ float camera_rotation_angle = 90;
 float rectangle_rotation = 0;
 float triangle_rotation = 0;
 
-/* Render the scene with openGL */
-/* Edit this function according to your assignment */
-void draw ()
+/* Frees the GPU side of an object made by create3DObject */
+void delete3DObject (struct VAO* vao)
 {
-  // clear the color and depth in the frame buffer
-  glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDeleteBuffers (1, &(vao->VertexBuffer));
+    glDeleteBuffers (1, &(vao->ColorBuffer));
+    glDeleteVertexArrays (1, &(vao->VertexArrayID));
+    delete vao;
+}
 
-  // use the loaded shader program
-  // Don't change unless you know what you are doing
-  glUseProgram (programID);
+/* Uploads floor regions the worker finished and frees the ones the player
+   has left behind */
+void streamFloor (int pos_x, int pos_z)
+{
+  static vector<StreamRegion*> upload, release;
+  upload.clear();
+  release.clear();
+  level_stream_update(&stream, pos_x, pos_z, upload, release);
+  for(size_t i=0;i<upload.size();i++)
+  {
+    StreamRegion* region = upload[i];
+    if(region->num_vertices > 0)
+      region->mesh = create3DObject(GL_TRIANGLES, region->num_vertices, &region->vertices[0], &region->colors[0], GL_FILL);
+    level_stream_uploaded(region);
+  }
+  for(size_t i=0;i<release.size();i++)
+  {
+    if(release[i]->mesh)
+      delete3DObject((VAO*)release[i]->mesh);
+    delete release[i];
+  }
+}
 
-  // Eye - Location of camera. Don't change unless you are sure!!
+/* Registered with atexit, the worker has to be joined before the globals
+   are destroyed */
+void stopStream ()
+{
+  vector<StreamRegion*> release;
+  level_stream_stop(&stream, release);
+  for(size_t i=0;i<release.size();i++)
+    delete release[i];
+}
 
-  if(flag==1 or flag==0)
+/* Everything draw() shows of the game. The simulation thread publishes a
+   new one whenever it changes, the render thread only ever reads these */
+struct Snapshot {
+  float eye[3];
+  float target[3];
+  int appear;
+  int pos_x, pos_z;
+  uint32_t input_seq;     // newest input event applied
+};
+TripleBuffer<Snapshot> snapshots;
+Snapshot shown_state;     // last one published
+SimThread sim;
+uint32_t input_seq = 0;   // simulation thread only
+LatencyLog latency;
+
+/* Publishes the scene if it is different from the last one published, the
+   frame on screen is out of date then. The first step always publishes */
+void publishSnapshot ()
+{
+  Snapshot state;
+  memset(&state, 0, sizeof(state));
+  state.eye[0] = eye.x;
+  state.eye[1] = eye.y;
+  state.eye[2] = eye.z;
+  state.target[0] = target.x;
+  state.target[1] = target.y;
+  state.target[2] = target.z;
+  state.appear = appear;
+  state.pos_x = pos_x;
+  state.pos_z = pos_z;
+  state.input_seq = input_seq;
+  if(sim_tick>0 && memcmp(&state, &shown_state, sizeof(state)) == 0)
+    return;
+  shown_state = state;
+  *triple_buffer_back(&snapshots) = state;
+  triple_buffer_publish(&snapshots);
+}
+
+/* One fixed step of the game: applies the input logged for it, then sends
+   the player back to the spawn if they fell or walked into something */
+void simulateStep ()
+{
+  InputEvent event;
+  while(input_log_poll(&input_log, sim_tick, &event))
   {
-    eye=glm::vec3(camera_x,camera_y,camera_z);
+    applyInput(&event);
+    latency_applied(&latency, &event);
+    input_seq = event.seq;
+  }
+  if(fallorcollide())
+  {
+    pos_x=level.header->spawn.x;
+    pos_z=level.header->spawn.z;
+    appear=0;
+  }
+  if(flag==4)
+  {
+    if(pos_y>=4 and !(fallorcollide()))
+    {
+      pos_y=6;
+    }
+    else
+    {
+      flag=3;
+    }
   }
-  else if(flag==2)
+
+  // Where the camera is, worked out here so draw() only has to read it
+  if(flag==2)
   {
     camera_x=pos_x+1;
     camera_z=pos_z;
     camera_y=5;
-    eye=glm::vec3(camera_x,camera_y,camera_z);
     target=glm::vec3(25,-1,pos_z);
   }
   else if(flag==3)
   {
-    eye=glm::vec3(camera_x,camera_y,camera_z);
     target=glm::vec3(35,0,camera_z);
   }
+  if(flag!=4)
+    eye=glm::vec3(camera_x,camera_y,camera_z);
+  publishSnapshot();
+  sim_tick++;
+}
+
+/* Runs on the simulation thread. Stops it once a replay has run out */
+bool runStep (double time)
+{
+  if(input_log_finished(&input_log, sim_tick))
+    return false;
+  simulateStep();
+  return true;
+}
+
+/* Registered with atexit, so quitting any way writes the recording */
+void saveInput ()
+{
+  input_log_save(&input_log, sim_tick);
+}
+
+/* Registered with atexit after saveInput, so the recording is only written
+   once the thread has stopped adding to it */
+void stopSimulation ()
+{
+  sim_thread_stop(&sim);
+}
+
+/* Times the input events this frame is the first to show, see latency.h.
+   Called right after the swap, with the seq of the newest event shown */
+void timeFrame (uint32_t seq)
+{
+  static GLsync fences[LATENCY_FRAMES];
+  static int frame = 0;
+  double now = sim_thread_now();
+  // Earlier frames the GPU has finished since the last look
+  for(int i=0;i<LATENCY_FRAMES;i++)
+  {
+    if(fences[i] && glClientWaitSync(fences[i], 0, 0) != GL_TIMEOUT_EXPIRED)
+    {
+      latency_completed(&latency, i, now);
+      glDeleteSync(fences[i]);
+      fences[i] = 0;
+    }
+  }
+  // Only if the GPU is LATENCY_FRAMES behind, which would be worth knowing
+  if(fences[frame])
+  {
+    glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    latency_completed(&latency, frame, sim_thread_now());
+    glDeleteSync(fences[frame]);
+    fences[frame] = 0;
+  }
+  if(latency_swapped(&latency, frame, seq, now))
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame = (frame+1)%LATENCY_FRAMES;
+}
+
+/* Registered with atexit, writes the --latency histogram */
+void saveLatency ()
+{
+  latency_save(&latency);
+}
+
+/* Render the scene with openGL */
+/* Edit this function according to your assignment */
+void draw ()
+{
+  // clear the color and depth in the frame buffer
+  glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // use the loaded shader program
+  // Don't change unless you know what you are doing
+  glUseProgram (programID);
+
+  // The game as of the last step that changed it
+  const Snapshot* s = triple_buffer_front(&snapshots);
+
+  // Eye - Location of camera. Don't change unless you are sure!!
   // Target - Where is the camera looking at.  Don't change unless you are sure!!
   // Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
   glm::vec3 up (1,0,0);
 
   // Compute Camera matrix (view)
-   Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
+   Matrices.view = glm::lookAt( glm::vec3(s->eye[0],s->eye[1],s->eye[2]), glm::vec3(s->target[0],s->target[1],s->target[2]), up ); // Rotating Camera for 3D
   //  Don't change unless you are sure!!
   //Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
 
@@ -765,139 +957,64 @@ void draw ()
   //  Don't change unless you are sure!!
   glm::mat4 MVP;	// MVP = Projection * View * Model
 
-
-  for(int k=0;k<6;k++)
+  // Floor, the columns under it and the obstacles, one draw per resident region
+  streamFloor(s->pos_x, s->pos_z);
+  MVP = VP;
+  glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
+  for(map<int64_t,StreamRegion*>::iterator it=stream.regions.begin();it!=stream.regions.end();++it)
   {
-    for(int i=0;i<6;i++)
-    {
-      for(int j=0;j<2;j++)
-      {
-        //glm::mat4 scalecube = glm::scale(glm::vec3(0.25f,0.25f,0.25f));
-        Matrices.model = glm::mat4(1.0f);
-        //glm::mat4 translatecube3 = glm::translate(glm::vec3(0.5f*i,0.5f*j,0.5f*k));
-        glm::mat4 translatecube3 = glm::translate(glm::vec3(2*i,2*j,2*k));
-        //Matrices.model*=(translatecube3*scalecube);
-        Matrices.model*=(translatecube3);
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        if(search(2*i,2*k)==1 and j==1)
-        {
-        }
-        else
-          draw3DObject(rectangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-j,0)))*scalecube);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-4*j,0)))*scalecube);
-        Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-4*j,0))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(rectangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-j,-k)))*scalecube);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-4*j,-4*k)))*scalecube);
-        Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,-4*j,-4*k))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(rectangle);
-
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,0,-k)))*scalecube);
-        Matrices.model*=(translatecube3*(glm::translate(glm::vec3(0,0,-4*k))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        if(search(2*i,-2*k) and j==1)
-        {
-
-        }
-        else
-          draw3DObject(rectangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //glm::mat4 translatecube4 = glm::translate(glm::vec3(-0.5f*i,0.5f*j,-0.5f*k));
-        glm::mat4 translatecube4 = glm::translate(glm::vec3(-2*i,2*j,-2*k));
-        //Matrices.model*=(translatecube4*scalecube);
-        Matrices.model*=(translatecube4);
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        if(search(-2*i,-2*k) and j==1)
-        {
-        }
-        else
-          draw3DObject(rectangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,-j,0)))*scalecube);
-        Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,-4*j,0))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(rectangle);
-
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,-j,k)))*scalecube);
-        Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,-4*j,4*k))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        draw3DObject(rectangle);
-
-        
-        Matrices.model = glm::mat4(1.0f);
-        //Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,0,k)))*scalecube);
-        Matrices.model*=(translatecube4*(glm::translate(glm::vec3(0,0,4*k))));
-        MVP = VP*Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-        if(search(-2*i,2*k) and j==1)
-        {
-        }
-        else
-          draw3DObject(rectangle);
-      }
-    }
+    if(it->second->mesh)
+      draw3DObject((VAO*)it->second->mesh);
   }
-  for(int i=0;i<7;i++)
+  if(s->appear ==1)
   {
     Matrices.model = glm::mat4(1.0f);
-    Matrices.model*=(glm::translate(glm::vec3(obs[i][0],4,obs[i][1])));
-    MVP = VP*Matrices.model;
-    glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
-    draw3DObject(rectangle);
-  }
-  if(appear ==1)
-  {
-    Matrices.model = glm::mat4(1.0f);
-    Matrices.model*=(glm::translate(glm::vec3(pos_x,4,pos_z)));
+    Matrices.model*=(glm::translate(glm::vec3(s->pos_x,4,s->pos_z)));
     MVP = VP*Matrices.model;
     glUniformMatrix4fv(Matrices.MatrixID,1,GL_FALSE,&MVP[0][0]);
     draw3DObject(triangle);
   }
-  if(fallorcollide())
-  {
-    pos_x=-10;
-    pos_z=-10;
-    appear=0;
-  }
-  if(flag==4)
-  {
-    if(pos_y>=4 and !(fallorcollide()))
-    {
-      pos_y=6;
-    }
-    else
-    {
-      flag=3;
-    }
-  }
-  glutSwapBuffers ();
+}
 
+/* Registered with atexit, writes out the frames still in flight while the
+   context is still there */
+void stopCapture ()
+{
+  if(capturing)
+    capture_close(&capture);
+  capturing = false;
+}
+
+/* GLUT display callback. draw() itself leaves the swap out, offscreen
+   frames have nothing to swap */
+void display ()
+{
+  draw();
+  if(capturing)
+    capture_frame(&capture);
+  glutSwapBuffers ();
+  timeFrame(triple_buffer_front(&snapshots)->input_seq);
 }
 
 /* Executed when the program is idle (no I/O activity) */
 void idle () {
-    // OpenGL should never stop drawing
-    // can draw the same scene or a modified scene
-    draw (); // drawing same scene
+    static double replay_start = -1;
+    if (replay_start < 0)
+        replay_start = frame_sched_now();
+    if (sim.finished) {
+        printf("Replayed %u steps in %.2f s\n", sim_tick, frame_sched_now() - replay_start);
+        exit (0);
+    }
+
+    // A new snapshot means the scene changed. Regions still on the worker
+    // only show up once a frame uploads them
+    if (triple_buffer_update(&snapshots) || !level_stream_settled(&stream))
+        frame_sched_request(&frame_sched);
+
+    // Sleeps until the next frame is due, or for a step at most, rather
+    // than drawing the same scene over and over
+    if (frame_sched_wait(&frame_sched, frame_sched_now() + SIM_STEP))
+        glutPostRedisplay ();
 }
 
 
@@ -935,7 +1052,7 @@ void initGLUT (int& argc, char** argv, int width, int height)
 
     glutReshapeFunc (reshapeWindow);
 
-    glutDisplayFunc (draw); // function to draw when active
+    glutDisplayFunc (display); // function to draw when active
     glutIdleFunc (idle); // function to draw when idle (no I/O activity)
     
     glutIgnoreKeyRepeat (true); // Ignore keys held down
@@ -997,12 +1114,117 @@ void initGL (int width, int height)
 	cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
 
+Offscreen offscreen;
+
+/* One frame of --offscreen: a step of the game, then the frame showing it.
+   False once a replay has run out, as in runStep() */
+bool offscreenFrame ()
+{
+  if(input_log_finished(&input_log, sim_tick))
+    return false;
+  simulateStep();
+  triple_buffer_update(&snapshots);
+  draw();
+  if(capturing)
+    capture_frame(&capture);
+  return true;
+}
+
+/* --offscreen WxH: draws 'frames' frames into a framebuffer of that size,
+   with no window, and prints how long they took. Timing starts once the
+   floor around the player has finished streaming in */
+int runOffscreen (int width, int height, int frames, const char* capture_path)
+{
+  if(!offscreen_open(&offscreen, width, height))
+    return 1;
+  // glewInit() wants a GLX display, the context here is EGL
+  glewExperimental = GL_TRUE;
+  GLenum err = glewContextInit();
+  if (err != GLEW_OK) {
+    cout << "Error: Failed to initialise GLEW : "<< glewGetErrorString(err) << endl;
+    return 1;
+  }
+  initGL (width, height);
+  level_stream_start(&stream, &level, &stream_config);
+  triple_buffer_init(&snapshots);
+  publishSnapshot();
+  triple_buffer_update(&snapshots);
+  // Only the floor moves on while it streams in. However long the worker
+  // takes, the game, and a replay, start on the first timed frame
+  do
+    draw();
+  while(!level_stream_settled(&stream));
+  if(capture_path)
+    capturing = capture_open(&capture, capture_path, width, height, 60, offscreen_proc_address);
+  offscreen_bench(&offscreen, frames, offscreenFrame);
+  stopCapture();
+  stopStream();
+  offscreen_close(&offscreen);
+  return 0;
+}
+
 int main (int argc, char** argv)
 {
 	int width = 1366;
 	int height = 768;
+  // Shaders come from assets.pak when it is present, loose files otherwise
+  asset_pack_open(&assets, "assets.pak");
+  // --level picks the level, looked up in the asset pack first. Floor
+  // regions further than --radius cells from the player are not kept
+  const char* level_path = "level.lvl";
+  level_stream_defaults(&stream_config);
+  stream_config.floor_y = 2;
+  // As deep as the old fixed loops drew it, y = 2 down to -2
+  stream_config.layers = 3;
+  // --record writes the session's input to a file, --replay plays one back,
+  // --latency writes a histogram of how long input took to show
+  input_log_init(&input_log);
+  latency_init(&latency);
+  // --frame picks when to draw, --redraw always draws unchanged frames too
+  frame_sched_init(&frame_sched);
+  // --offscreen WxH --frames N times drawing N frames of that size.
+  // --capture file.y4m or file.png writes out the frames drawn
+  int offscreen_width = 0, offscreen_height = 0, frames = 300;
+  const char* capture_path = NULL;
+  for(int i=1;i+1<argc;i++)
+  {
+    if(strcmp(argv[i], "--level") == 0)
+      level_path = argv[i+1];
+    else if(strcmp(argv[i], "--radius") == 0)
+      stream_config.radius = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "--record") == 0)
+      input_log_record(&input_log, argv[i+1]);
+    else if(strcmp(argv[i], "--replay") == 0 && !input_log_replay(&input_log, argv[i+1]))
+      return 1;
+    else if(strcmp(argv[i], "--latency") == 0)
+      latency_record(&latency, argv[i+1]);
+    else if(strcmp(argv[i], "--frame") == 0 && !frame_sched_parse(&frame_sched, argv[i+1]))
+    {
+      cout << "--frame takes vsync, demand or a frame rate" << endl;
+      return 1;
+    }
+    else if(strcmp(argv[i], "--redraw") == 0 && !frame_sched_parse_redraw(&frame_sched, argv[i+1]))
+    {
+      cout << "--redraw takes changed or always" << endl;
+      return 1;
+    }
+    else if(strcmp(argv[i], "--capture") == 0)
+      capture_path = argv[i+1];
+    else if(strcmp(argv[i], "--frames") == 0)
+      frames = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "--offscreen") == 0 &&
+            !offscreen_parse_size(argv[i+1], &offscreen_width, &offscreen_height))
+    {
+      cout << "--offscreen takes a size like 1920x1080" << endl;
+      return 1;
+    }
+  }
+  // Hole and obstacle layout, mapped and used in place
+  if(!level_open_asset(&level, &assets, level_path))
+    return 1;
   missing();
-  obstacle();
+  if(offscreen_width > 0)
+    return runOffscreen(offscreen_width, offscreen_height, frames, capture_path);
   if(lives>=0)
   {
     initGLUT (argc, argv, width, height);
@@ -1010,6 +1232,31 @@ int main (int argc, char** argv)
     addGLUTMenus ();
 
 	initGL (width, height);
+    // The video plays at a fixed rate, so every frame is drawn at that
+    // rate, whether anything changed or not
+    if(capture_path)
+    {
+      frame_sched.mode = FRAME_FIXED;
+      frame_sched.skip_unchanged = false;
+    }
+    frame_sched_start(&frame_sched);
+
+    level_stream_start(&stream, &level, &stream_config);
+    atexit(stopStream);
+    atexit(saveInput);
+    atexit(saveLatency);
+
+    // The game runs on its own thread from here on, draw() only sees the
+    // snapshots it publishes
+    triple_buffer_init(&snapshots);
+    publishSnapshot();
+    triple_buffer_update(&snapshots);
+    sim_thread_start(&sim, SIM_STEP, MAX_FRAME_TIME, runStep);
+    atexit(stopSimulation);
+    // Last registered, so it runs first, with the window still open
+    if(capture_path)
+      capturing = capture_open(&capture, capture_path, width, height, (int)(frame_sched.fps + 0.5), (void* (*)(const char*)) glutGetProcAddress);
+    atexit(stopCapture);
 
     glutMainLoop ();
   }
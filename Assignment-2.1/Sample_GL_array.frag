@@ -0,0 +1,15 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec3 fragTexCoord;
+
+// One layer per tile material
+uniform sampler2DArray tiles;
+
+// output data
+out vec3 color;
+
+void main()
+{
+    color = texture(tiles, fragTexCoord).rgb;
+}
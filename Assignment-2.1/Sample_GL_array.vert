@@ -0,0 +1,21 @@
+#version 330 core
+
+// input data : sent from main program
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec3 vertexTexCoord; // u, v, texture array layer
+
+uniform mat4 MVP;
+
+// output data : used by fragment shader
+out vec3 fragTexCoord;
+
+void main ()
+{
+    vec4 v = vec4(vertexPosition, 1); // Transform an homogeneous 4D vector
+
+    // The layer is constant across a face, only u and v get interpolated
+    fragTexCoord = vertexTexCoord;
+
+    // Output position of the vertex, in clip space : MVP * position
+    gl_Position = MVP * v;
+}
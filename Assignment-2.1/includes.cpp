@@ -1,53 +1,114 @@
 #include "includes.h"
+#include "pixel_convert.h"
 
-GLuint loadBMP_custom(const char * imagepath)
+#include <string.h>
+
+/* Reads a little endian 32 bit field out of the BMP header */
+static int bmp_field(const unsigned char * header, int offset)
+{
+    int value;
+    memcpy(&value, header + offset, 4);
+    return value;
+}
+
+bool decodeBMP(const unsigned char * bytes, size_t size, BMPImage * image)
+{
+    // Each BMP file begins by a 54-bytes header
+    if (size < 54 || bytes[0]!='B' || bytes[1]!='M') {
+        printf("Not a correct BMP file\n");
+        return false;
+    }
+    //Read ints from byte array
+    unsigned int dataPos = bmp_field(bytes, 0x0A);
+    int width            = bmp_field(bytes, 0x12);
+    int height           = bmp_field(bytes, 0x16);
+    int bpp              = bytes[0x1C] | (bytes[0x1D] << 8);
+
+    if (bpp != 24 || width <= 0 || height == 0) {
+        printf("Only uncompressed 24 bit BMP files are supported\n");
+        return false;
+    }
+    // The BMP header is done that way
+    if (dataPos==0)
+        dataPos=54;
+
+    // Negative height means the rows are stored top to bottom, while GL wants
+    // the bottom row first
+    bool flip = height < 0;
+    if (flip)
+        height = -height;
+
+    // Rows are padded to a multiple of 4 bytes
+    size_t stride = ((size_t)width*3 + 3) & ~(size_t)3;
+    if (dataPos > size || (size - dataPos) / stride < (size_t)height) {
+        printf("BMP file is truncated\n");
+        return false;
+    }
+
+    // Swizzle to RGBA here so uploads take the driver's fast path
+    image->width = width;
+    image->height = height;
+    image->rgba.resize((size_t)width*height*4);
+    bgr_to_rgba(&image->rgba[0], bytes + dataPos, width, height, stride, flip);
+    return true;
+}
+
+bool readBMP(const AssetPack * pack, const char * imagepath, BMPImage * image)
 {
-	Data read from the header of the BMP file
-    unsigned char header[54]; // Each BMP file begins by a 54-bytes header
-    unsigned int dataPos;     // Position in the file where the actual data  begins
-    unsigned int width, height;
-    unsigned int imageSize;   // = width*height*3
-    // Actual RGB data
-    unsigned char * data;
+    AssetView view;
+    if (asset_pack_find(pack, imagepath, &view))
+        return decodeBMP(view.data, view.size, image);
 
     FILE * file = fopen(imagepath,"rb");
-    if (!file)                              
+    if (!file)
     {
-        printf("Image could not be opened\n"); 
-        return 0;
-    }
-    if ( fread(header, 1, 54, file)!=54 ){ // If not 54 bytes read : problem
-        printf("Not a correct BMP file\n");
+        printf("Image could not be opened\n");
         return false;
     }
-    if ( header[0]!='B' || header[1]!='M' ){
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
         printf("Not a correct BMP file\n");
-        return 0;
+        fclose(file);
+        return false;
     }
-    //Read ints from byte array
-    dataPos    = *(int*)&(header[0x0A]);
-    imageSize  = *(int*)&(header[0x22]);
-    width      = *(int*)&(header[0x12]);
-    height     = *(int*)&(header[0x16]);
-
-    // Some BMP files are misformatted, guess missing information
-    if (imageSize==0)    
-        imageSize=width*height*3; // 3 : one byte for each Red, Green and Blue component
-    if (dataPos==0)      
-        dataPos=54; // The BMP header is done that way
-    data = new unsigned char [imageSize];
-    fread(data,1,imageSize,file);
+
+    std::vector<unsigned char> bytes(size);
+    size_t got = fread(&bytes[0], 1, size, file);
     fclose(file);
 
+    return decodeBMP(&bytes[0], got, image);
+}
+
+static GLuint uploadBMP(const BMPImage & image)
+{
     GLuint textureID;
     glGenTextures(1, &textureID);
 
     glBindTexture(GL_TEXTURE_2D, textureID);
 
-    glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-     
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &image.rgba[0]);
+
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
     return textureID;
-}
\ No newline at end of file
+}
+
+GLuint loadBMP_memory(const unsigned char * bytes, size_t size)
+{
+    BMPImage image;
+    if (!decodeBMP(bytes, size, &image))
+        return 0;
+    return uploadBMP(image);
+}
+
+GLuint loadBMP_custom(const char * imagepath)
+{
+    AssetPack none = {};
+    BMPImage image;
+    if (!readBMP(&none, imagepath, &image))
+        return 0;
+    return uploadBMP(image);
+}
@@ -1,3 +1,6 @@
+#ifndef INCLUDES_H
+#define INCLUDES_H
+
 #include <iostream>
 #include <cmath>
 #include <fstream>
@@ -12,4 +15,20 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-GLuint loadBMP_custom(const char * imagepath);
\ No newline at end of file
+#include "asset_pack.h"
+
+/* A decoded BMP, bottom row first, 4 bytes per pixel */
+struct BMPImage {
+    int width;
+    int height;
+    std::vector<unsigned char> rgba;
+};
+
+bool decodeBMP(const unsigned char * bytes, size_t size, BMPImage * image);
+/* Decodes 'imagepath' out of the pack if it is there, from the file otherwise */
+bool readBMP(const AssetPack * pack, const char * imagepath, BMPImage * image);
+
+GLuint loadBMP_custom(const char * imagepath);
+GLuint loadBMP_memory(const unsigned char * bytes, size_t size);
+
+#endif
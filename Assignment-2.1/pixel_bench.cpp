@@ -0,0 +1,74 @@
+/* Throughput of the BGR -> RGBA texture kernels against the scalar reference.
+   Usage: pixel_bench [width] [height] [iterations] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "pixel_convert.h"
+
+using namespace std;
+
+static double run(pixel_row_fn fn, unsigned char * dst, const unsigned char * src, int width, int height, size_t stride, int iterations)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int it=0; it<iterations; it++)
+        for (int y=0; y<height; y++)
+            fn(dst + (size_t)y*width*4, src + (size_t)y*stride, width);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main (int argc, char** argv)
+{
+    // Odd default width so the row padding and the scalar tails get exercised
+    int width = argc > 1 ? atoi(argv[1]) : 4093;
+    int height = argc > 2 ? atoi(argv[2]) : 2048;
+    int iterations = argc > 3 ? atoi(argv[3]) : 20;
+    if (width <= 0 || height <= 0 || iterations <= 0) {
+        printf("usage: %s [width] [height] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    size_t stride = ((size_t)width*3 + 3) & ~(size_t)3;
+    vector<unsigned char> src(stride*height);
+    srand(1);
+    for (size_t i=0; i<src.size(); i++)
+        src[i] = rand() & 255;
+
+    size_t out_size = (size_t)width*height*4;
+    vector<unsigned char> reference(out_size), out(out_size);
+
+    struct { const char * name; pixel_row_fn fn; } kernels[] = {
+        { "scalar", bgr_to_rgba_row_scalar },
+        { "ssse3",  bgr_to_rgba_row_ssse3 },
+        { "avx2",   bgr_to_rgba_row_avx2 },
+    };
+
+    run(bgr_to_rgba_row_scalar, &reference[0], &src[0], width, height, stride, 1);
+
+    double mb = (double)width*height*3*iterations / (1024.0*1024.0);
+    printf("%dx%d, %d iterations, best kernel: %s\n", width, height, iterations, pixel_kernel_name(bgr_to_rgba_row_best()));
+
+    double scalar_time = 0;
+    int status = 0;
+    for (size_t k=0; k<sizeof(kernels)/sizeof(kernels[0]); k++) {
+#if defined(__x86_64__) || defined(__i386__)
+        if ((kernels[k].fn == bgr_to_rgba_row_ssse3 && !__builtin_cpu_supports("ssse3")) ||
+            (kernels[k].fn == bgr_to_rgba_row_avx2 && !__builtin_cpu_supports("avx2"))) {
+            printf("%-8s unsupported on this CPU\n", kernels[k].name);
+            continue;
+        }
+#endif
+        memset(&out[0], 0, out_size);
+        double t = run(kernels[k].fn, &out[0], &src[0], width, height, stride, iterations);
+        if (k == 0)
+            scalar_time = t;
+        bool ok = memcmp(&out[0], &reference[0], out_size) == 0;
+        if (!ok)
+            status = 1;
+        printf("%-8s %10.1f MB/s  %5.2fx  %s\n", kernels[k].name, mb/t, scalar_time/t, ok ? "ok" : "MISMATCH");
+    }
+    return status;
+}
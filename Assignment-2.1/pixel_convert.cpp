@@ -0,0 +1,132 @@
+#include "pixel_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_X86 1
+#endif
+
+void bgr_to_rgba_row_scalar(unsigned char * dst, const unsigned char * src, int width)
+{
+    for (int i=0; i<width; i++) {
+        dst[4*i]     = src[3*i + 2];
+        dst[4*i + 1] = src[3*i + 1];
+        dst[4*i + 2] = src[3*i];
+        dst[4*i + 3] = 255;
+    }
+}
+
+#ifdef PIXEL_X86
+
+/* Shuffle for a 16 byte load whose first 12 bytes are 4 BGR pixels */
+#define BGR_SHUFFLE_LO 2,1,0,-128, 5,4,3,-128, 8,7,6,-128, 11,10,9,-128
+/* Same, for a load that starts 4 bytes before the pixels. Used for the last
+   group of a block so we never read past the end of the row */
+#define BGR_SHUFFLE_HI 6,5,4,-128, 9,8,7,-128, 12,11,10,-128, 15,14,13,-128
+
+__attribute__((target("ssse3")))
+void bgr_to_rgba_row_ssse3(unsigned char * dst, const unsigned char * src, int width)
+{
+    const __m128i lo = _mm_setr_epi8(BGR_SHUFFLE_LO);
+    const __m128i hi = _mm_setr_epi8(BGR_SHUFFLE_HI);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+    int i = 0;
+    // 16 pixels per iteration : 48 bytes in, 64 bytes out
+    for (; i+16<=width; i+=16) {
+        const unsigned char * s = src + 3*i;
+        __m128i a = _mm_loadu_si128((const __m128i*)(s));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + 12));
+        __m128i c = _mm_loadu_si128((const __m128i*)(s + 24));
+        __m128i d = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i* o = (__m128i*)(dst + 4*i);
+        _mm_storeu_si128(o,     _mm_or_si128(_mm_shuffle_epi8(a, lo), alpha));
+        _mm_storeu_si128(o + 1, _mm_or_si128(_mm_shuffle_epi8(b, lo), alpha));
+        _mm_storeu_si128(o + 2, _mm_or_si128(_mm_shuffle_epi8(c, lo), alpha));
+        _mm_storeu_si128(o + 3, _mm_or_si128(_mm_shuffle_epi8(d, hi), alpha));
+    }
+    bgr_to_rgba_row_scalar(dst + 4*i, src + 3*i, width - i);
+}
+
+static inline __attribute__((target("avx2"))) __m256i load_lanes(const unsigned char * l, const unsigned char * h)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)l)),
+                                   _mm_loadu_si128((const __m128i*)h), 1);
+}
+
+__attribute__((target("avx2")))
+void bgr_to_rgba_row_avx2(unsigned char * dst, const unsigned char * src, int width)
+{
+    // vpshufb works per 128 bit lane, so each lane gets its own 4 pixel load
+    const __m256i lo = _mm256_setr_epi8(BGR_SHUFFLE_LO, BGR_SHUFFLE_LO);
+    const __m256i last = _mm256_setr_epi8(BGR_SHUFFLE_LO, BGR_SHUFFLE_HI);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+    int i = 0;
+    // 32 pixels per iteration : 96 bytes in, 128 bytes out
+    for (; i+32<=width; i+=32) {
+        const unsigned char * s = src + 3*i;
+        __m256i a = load_lanes(s,      s + 12);
+        __m256i b = load_lanes(s + 24, s + 36);
+        __m256i c = load_lanes(s + 48, s + 60);
+        __m256i d = load_lanes(s + 72, s + 80);
+        __m256i* o = (__m256i*)(dst + 4*i);
+        _mm256_storeu_si256(o,     _mm256_or_si256(_mm256_shuffle_epi8(a, lo), alpha));
+        _mm256_storeu_si256(o + 1, _mm256_or_si256(_mm256_shuffle_epi8(b, lo), alpha));
+        _mm256_storeu_si256(o + 2, _mm256_or_si256(_mm256_shuffle_epi8(c, lo), alpha));
+        _mm256_storeu_si256(o + 3, _mm256_or_si256(_mm256_shuffle_epi8(d, last), alpha));
+    }
+    bgr_to_rgba_row_ssse3(dst + 4*i, src + 3*i, width - i);
+}
+
+pixel_row_fn bgr_to_rgba_row_best()
+{
+    static pixel_row_fn best = 0;
+    if (!best) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            best = bgr_to_rgba_row_avx2;
+        else if (__builtin_cpu_supports("ssse3"))
+            best = bgr_to_rgba_row_ssse3;
+        else
+            best = bgr_to_rgba_row_scalar;
+    }
+    return best;
+}
+
+#else
+
+/* No SIMD kernels on this architecture - fall back to the reference loop */
+void bgr_to_rgba_row_ssse3(unsigned char * dst, const unsigned char * src, int width)
+{
+    bgr_to_rgba_row_scalar(dst, src, width);
+}
+
+void bgr_to_rgba_row_avx2(unsigned char * dst, const unsigned char * src, int width)
+{
+    bgr_to_rgba_row_scalar(dst, src, width);
+}
+
+pixel_row_fn bgr_to_rgba_row_best()
+{
+    return bgr_to_rgba_row_scalar;
+}
+
+#endif
+
+const char * pixel_kernel_name(pixel_row_fn fn)
+{
+    if (fn == bgr_to_rgba_row_avx2)
+        return "avx2";
+    if (fn == bgr_to_rgba_row_ssse3)
+        return "ssse3";
+    return "scalar";
+}
+
+void bgr_to_rgba(unsigned char * dst, const unsigned char * src, int width, int height, size_t src_stride, bool flip)
+{
+    pixel_row_fn row = bgr_to_rgba_row_best();
+    for (int y=0; y<height; y++) {
+        const unsigned char * s = src + (size_t)(flip ? height-1-y : y)*src_stride;
+        row(dst + (size_t)y*width*4, s, width);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <stddef.h>
+
+/* Converts one row of 'width' 24-bit BGR pixels into 32-bit RGBA (alpha = 255) */
+typedef void (*pixel_row_fn)(unsigned char * dst, const unsigned char * src, int width);
+
+void bgr_to_rgba_row_scalar(unsigned char * dst, const unsigned char * src, int width);
+void bgr_to_rgba_row_ssse3(unsigned char * dst, const unsigned char * src, int width);
+void bgr_to_rgba_row_avx2(unsigned char * dst, const unsigned char * src, int width);
+
+/* Fastest row kernel the running CPU supports, and its name for logging */
+pixel_row_fn bgr_to_rgba_row_best();
+const char * pixel_kernel_name(pixel_row_fn fn);
+
+/* Converts a whole BGR image into tightly packed RGBA.
+   src_stride is the size of one source row in bytes, so BMP row padding is
+   skipped while decoding. With flip set the rows are written bottom to top. */
+void bgr_to_rgba(unsigned char * dst, const unsigned char * src, int width, int height, size_t src_stride, bool flip);
+
+#endif
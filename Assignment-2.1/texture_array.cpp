@@ -0,0 +1,73 @@
+#include "texture_array.h"
+
+#include <string.h>
+
+void texture_array_init(TextureArrayBuilder * builder, int tile_width, int tile_height)
+{
+    builder->tile_width = tile_width;
+    builder->tile_height = tile_height;
+    builder->layers = 0;
+    builder->texels.clear();
+}
+
+/* Copies the tile whose bottom left corner is at (x, y) of 'image' into a new layer */
+static void add_tile(TextureArrayBuilder * builder, const BMPImage & image, int x, int y)
+{
+    size_t row_bytes = (size_t)builder->tile_width*4;
+    size_t layer_bytes = row_bytes*builder->tile_height;
+    builder->texels.resize(layer_bytes*(builder->layers + 1));
+
+    unsigned char * dst = &builder->texels[layer_bytes*builder->layers];
+    for (int row=0; row<builder->tile_height; row++) {
+        const unsigned char * src = &image.rgba[(((size_t)y + row)*image.width + x)*4];
+        memcpy(dst + row*row_bytes, src, row_bytes);
+    }
+    builder->layers++;
+}
+
+bool texture_array_add(TextureArrayBuilder * builder, const BMPImage & image)
+{
+    if (image.width != builder->tile_width || image.height != builder->tile_height) {
+        printf("Texture layer is %dx%d, expected %dx%d\n", image.width, image.height,
+               builder->tile_width, builder->tile_height);
+        return false;
+    }
+    add_tile(builder, image, 0, 0);
+    return true;
+}
+
+int texture_array_add_sheet(TextureArrayBuilder * builder, const BMPImage & sheet)
+{
+    if (builder->tile_width <= 0 || builder->tile_height <= 0)
+        return 0;
+    int across = sheet.width / builder->tile_width;
+    int down = sheet.height / builder->tile_height;
+
+    // Rows are stored bottom up, so start from the top of the sheet
+    for (int ty=0; ty<down; ty++)
+        for (int tx=0; tx<across; tx++)
+            add_tile(builder, sheet, tx*builder->tile_width, sheet.height - (ty + 1)*builder->tile_height);
+    return across*down;
+}
+
+GLuint texture_array_upload(const TextureArrayBuilder * builder)
+{
+    if (builder->layers == 0)
+        return 0;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, builder->tile_width, builder->tile_height,
+                 builder->layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, &builder->texels[0]);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    return textureID;
+}
@@ -0,0 +1,27 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include "includes.h"
+
+/* Collects equally sized tile materials and uploads them as the layers of a
+   single GL_TEXTURE_2D_ARRAY, so a whole level can be drawn with one bind */
+struct TextureArrayBuilder {
+    int tile_width;
+    int tile_height;
+    int layers;
+    std::vector<unsigned char> texels;   // RGBA, layer after layer
+};
+
+void texture_array_init(TextureArrayBuilder * builder, int tile_width, int tile_height);
+
+/* Adds one image as a layer. It must match the tile size exactly */
+bool texture_array_add(TextureArrayBuilder * builder, const BMPImage & image);
+
+/* Cuts a tile sheet into as many whole tiles as fit, left to right and top to
+   bottom, and adds each as a layer. Returns the number of layers added */
+int texture_array_add_sheet(TextureArrayBuilder * builder, const BMPImage & sheet);
+
+/* Uploads all layers (with mipmaps) and returns the texture, or 0 if empty */
+GLuint texture_array_upload(const TextureArrayBuilder * builder);
+
+#endif
@@ -0,0 +1,102 @@
+#include "asset_pack.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Asset packs are used in place and are little endian"
+#endif
+
+static bool pack_valid(const unsigned char * base, size_t size)
+{
+    if (size < sizeof(PackHeader))
+        return false;
+    const PackHeader * header = (const PackHeader *)base;
+    if (memcmp(header->magic, PACK_MAGIC, 4) != 0 || header->version != PACK_VERSION)
+        return false;
+    if (header->entry_size != sizeof(PackEntry) || header->file_size != size)
+        return false;
+    if ((size - sizeof(PackHeader)) / sizeof(PackEntry) < header->count)
+        return false;
+
+    const PackEntry * entries = (const PackEntry *)(base + sizeof(PackHeader));
+    for (uint32_t i=0; i<header->count; i++) {
+        if (memchr(entries[i].name, 0, PACK_NAME_LEN) == NULL)
+            return false;
+        if (entries[i].offset > size || size - entries[i].offset <= entries[i].size)
+            return false;
+        // Shaders are used as C strings straight out of the mapping
+        if (base[entries[i].offset + entries[i].size] != 0)
+            return false;
+        // asset_pack_find() searches the index by halves
+        if (i > 0 && strcmp(entries[i-1].name, entries[i].name) >= 0)
+            return false;
+    }
+    return true;
+}
+
+bool asset_pack_open(AssetPack * pack, const char * path)
+{
+    memset(pack, 0, sizeof(*pack));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void * base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    if (!pack_valid((const unsigned char *)base, st.st_size)) {
+        printf("%s is not a valid asset pack\n", path);
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    pack->base = base;
+    pack->size = st.st_size;
+    pack->header = (const PackHeader *)base;
+    pack->entries = (const PackEntry *)((const unsigned char *)base + sizeof(PackHeader));
+    return true;
+}
+
+void asset_pack_close(AssetPack * pack)
+{
+    if (pack->base)
+        munmap(pack->base, pack->size);
+    memset(pack, 0, sizeof(*pack));
+}
+
+bool asset_pack_find(const AssetPack * pack, const char * name, AssetView * view)
+{
+    if (!pack->base)
+        return false;
+
+    // The packer writes the index sorted by name
+    uint32_t lo = 0, hi = pack->header->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo)/2;
+        int cmp = strcmp(pack->entries[mid].name, name);
+        if (cmp == 0) {
+            view->data = (const unsigned char *)pack->base + pack->entries[mid].offset;
+            view->size = pack->entries[mid].size;
+            return true;
+        }
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Asset pack layout (all fields little endian):
+ *
+ *   PackHeader
+ *   PackEntry[count]      sorted by name
+ *   blobs                 each starting on a PACK_ALIGN boundary and followed
+ *                         by a NUL byte that is not counted in its size
+ */
+#define PACK_MAGIC "GPAK"
+#define PACK_VERSION 1
+#define PACK_ALIGN 64
+#define PACK_NAME_LEN 56
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t entry_size;
+    uint64_t file_size;
+};
+
+struct PackEntry {
+    char name[PACK_NAME_LEN];
+    uint64_t offset;
+    uint64_t size;
+};
+
+/* A view into the mapped pack. Valid until asset_pack_close() */
+struct AssetView {
+    const unsigned char * data;
+    size_t size;
+};
+
+struct AssetPack {
+    void * base;
+    size_t size;
+    const PackHeader * header;
+    const PackEntry * entries;
+};
+
+/* Maps the pack at 'path'. Returns false (leaving the pack empty) if the file
+   is missing or malformed, so callers can fall back to loose files */
+bool asset_pack_open(AssetPack * pack, const char * path);
+void asset_pack_close(AssetPack * pack);
+
+/* Looks 'name' up in the index. An empty pack never finds anything */
+bool asset_pack_find(const AssetPack * pack, const char * name, AssetView * view);
+
+#endif
@@ -0,0 +1,375 @@
+#include "capture.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+/* Looked up from the program's context, the programs each bring their own
+   loader */
+static PFNGLGENBUFFERSPROC gen_buffers;
+static PFNGLDELETEBUFFERSPROC delete_buffers;
+static PFNGLBINDBUFFERPROC bind_buffer;
+static PFNGLBUFFERDATAPROC buffer_data;
+static PFNGLMAPBUFFERRANGEPROC map_buffer_range;
+static PFNGLUNMAPBUFFERPROC unmap_buffer;
+static PFNGLFENCESYNCPROC fence_sync;
+static PFNGLCLIENTWAITSYNCPROC client_wait_sync;
+static PFNGLDELETESYNCPROC delete_sync;
+static void (*read_pixels)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void *);
+
+/* Longest a readback is waited for, it is normally long done */
+#define FENCE_TIMEOUT 1000000000
+
+/* Largest stored deflate block */
+#define STORED_BLOCK 65535
+
+static bool load_functions(void * (*get_proc)(const char * name))
+{
+    gen_buffers = (PFNGLGENBUFFERSPROC)get_proc("glGenBuffers");
+    delete_buffers = (PFNGLDELETEBUFFERSPROC)get_proc("glDeleteBuffers");
+    bind_buffer = (PFNGLBINDBUFFERPROC)get_proc("glBindBuffer");
+    buffer_data = (PFNGLBUFFERDATAPROC)get_proc("glBufferData");
+    map_buffer_range = (PFNGLMAPBUFFERRANGEPROC)get_proc("glMapBufferRange");
+    unmap_buffer = (PFNGLUNMAPBUFFERPROC)get_proc("glUnmapBuffer");
+    fence_sync = (PFNGLFENCESYNCPROC)get_proc("glFenceSync");
+    client_wait_sync = (PFNGLCLIENTWAITSYNCPROC)get_proc("glClientWaitSync");
+    delete_sync = (PFNGLDELETESYNCPROC)get_proc("glDeleteSync");
+    read_pixels = (void (*)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void *))get_proc("glReadPixels");
+    return gen_buffers && delete_buffers && bind_buffer && buffer_data && map_buffer_range &&
+           unmap_buffer && fence_sync && client_wait_sync && delete_sync && read_pixels;
+}
+
+static void put32(std::vector<unsigned char> & out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+static uint32_t crc_table[256];
+
+static void crc_init()
+{
+    for (uint32_t n=0; n<256; n++) {
+        uint32_t c = n;
+        for (int k=0; k<8; k++)
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc32(const unsigned char * data, size_t size)
+{
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i=0; i<size; i++)
+        c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+static uint32_t adler32(const unsigned char * data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // The most bytes before b can overflow
+        size_t n = size < 5552 ? size : 5552;
+        size -= n;
+        while (n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+/* Appends a chunk: length, type, data and the CRC of the last two */
+static void put_chunk(std::vector<unsigned char> & out, const char * type, const std::vector<unsigned char> & data)
+{
+    put32(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put32(out, crc32(&out[start], out.size() - start));
+}
+
+/* RGB PNG of a bottom-up RGBA frame, the image data in stored deflate
+   blocks, so nothing is compressed */
+static bool write_png(const char * path, const unsigned char * rgba, int width, int height)
+{
+    // Scanlines top row first, each behind a 'no filter' byte
+    size_t stride = 1 + 3*(size_t)width;
+    std::vector<unsigned char> raw(stride*height);
+    for (int y=0; y<height; y++) {
+        unsigned char * row = &raw[y*stride];
+        const unsigned char * src = rgba + (size_t)(height - 1 - y)*width*4;
+        row[0] = 0;
+        for (int x=0; x<width; x++) {
+            row[1 + 3*x] = src[4*x];
+            row[2 + 3*x] = src[4*x + 1];
+            row[3 + 3*x] = src[4*x + 2];
+        }
+    }
+
+    std::vector<unsigned char> zlib;
+    zlib.reserve(raw.size() + raw.size()/STORED_BLOCK*5 + 11);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t offset = 0;
+    do {
+        size_t n = raw.size() - offset < STORED_BLOCK ? raw.size() - offset : STORED_BLOCK;
+        zlib.push_back(offset + n == raw.size());      // BFINAL, BTYPE 00
+        zlib.push_back(n & 0xFF);
+        zlib.push_back(n >> 8);
+        zlib.push_back(~n & 0xFF);
+        zlib.push_back((~n >> 8) & 0xFF);
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + n);
+        offset += n;
+    } while (offset < raw.size());
+    put32(zlib, adler32(&raw[0], raw.size()));
+
+    std::vector<unsigned char> header;
+    put32(header, width);
+    put32(header, height);
+    header.push_back(8);        // bits per channel
+    header.push_back(2);        // RGB
+    header.push_back(0);        // deflate
+    header.push_back(0);        // adaptive filtering
+    header.push_back(0);        // not interlaced
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<unsigned char> png(signature, signature + 8);
+    put_chunk(png, "IHDR", header);
+    put_chunk(png, "IDAT", zlib);
+    put_chunk(png, "IEND", std::vector<unsigned char>());
+
+    FILE * file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(&png[0], 1, png.size(), file) == png.size();
+    return fclose(file) == 0 && ok;
+}
+
+/* One 4:2:0 frame of a bottom-up RGBA image, full range BT.601 to match
+   the C420jpeg header. Chroma is the average of each 2x2 block */
+static bool write_y4m_frame(FILE * file, const unsigned char * rgba, int width, int height,
+                            std::vector<unsigned char> & yuv)
+{
+    int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    yuv.resize((size_t)width*height + 2*(size_t)cw*ch);
+    unsigned char * luma = &yuv[0];
+    unsigned char * cb = luma + (size_t)width*height;
+    unsigned char * cr = cb + (size_t)cw*ch;
+
+    for (int y=0; y<height; y++) {
+        const unsigned char * src = rgba + (size_t)(height - 1 - y)*width*4;
+        for (int x=0; x<width; x++) {
+            const unsigned char * p = src + 4*x;
+            luma[(size_t)y*width + x] = (77*p[0] + 150*p[1] + 29*p[2] + 128) >> 8;
+        }
+    }
+    for (int y=0; y<ch; y++)
+        for (int x=0; x<cw; x++) {
+            int r = 0, g = 0, b = 0, n = 0;
+            for (int dy=0; dy<2 && 2*y + dy<height; dy++)
+                for (int dx=0; dx<2 && 2*x + dx<width; dx++) {
+                    const unsigned char * p = rgba + ((size_t)(height - 1 - 2*y - dy)*width + 2*x + dx)*4;
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    n++;
+                }
+            // Scaled by 256*n, rounded, offset to 128
+            int u = (-43*r - 85*g + 128*b + 128*n) / n;
+            int v = (128*r - 107*g - 21*b + 128*n) / n;
+            cb[(size_t)y*cw + x] = std::min((128*256 + u) >> 8, 255);
+            cr[(size_t)y*cw + x] = std::min((128*256 + v) >> 8, 255);
+        }
+
+    return fputs("FRAME\n", file) >= 0 && fwrite(&yuv[0], 1, yuv.size(), file) == yuv.size();
+}
+
+/* name.png becomes name_00042.png */
+static std::string frame_path(const std::string & path, uint32_t number)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_%05u.png", number);
+    return path.substr(0, path.size() - 4) + suffix;
+}
+
+static void encoder_main(Capture * capture)
+{
+    std::vector<unsigned char> scratch;
+    std::unique_lock<std::mutex> guard(capture->lock);
+    while (true) {
+        while (capture->todo.empty() && !capture->quit)
+            capture->wake.wait(guard);
+        if (capture->todo.empty())
+            return;
+        CaptureFrame * frame = capture->todo.front();
+        capture->todo.pop_front();
+        capture->space.notify_one();
+        guard.unlock();
+
+        bool ok;
+        if (capture->format == CAPTURE_Y4M)
+            ok = write_y4m_frame(capture->video, &frame->pixels[0], capture->width, capture->height, scratch);
+        else
+            ok = write_png(frame_path(capture->path, frame->number).c_str(), &frame->pixels[0],
+                           capture->width, capture->height);
+
+        guard.lock();
+        if (!ok && !capture->failed) {
+            printf("Could not write frame %u of %s\n", frame->number, capture->path.c_str());
+            capture->failed = true;
+        }
+        capture->written++;
+        capture->spare.push_back(frame);
+    }
+}
+
+static bool ends_with(const char * s, const char * suffix)
+{
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+bool capture_open(Capture * capture, const char * path, int width, int height, int fps,
+                  void * (*get_proc)(const char * name))
+{
+    if (ends_with(path, ".y4m"))
+        capture->format = CAPTURE_Y4M;
+    else if (ends_with(path, ".png"))
+        capture->format = CAPTURE_PNG;
+    else {
+        printf("Capture %s should end in .y4m or .png\n", path);
+        return false;
+    }
+    if (!load_functions(get_proc)) {
+        printf("The GL context cannot capture, it has no pixel buffers or syncs\n");
+        return false;
+    }
+    crc_init();
+
+    capture->path = path;
+    capture->width = width;
+    capture->height = height;
+    capture->fps = fps;
+    capture->video = NULL;
+    if (capture->format == CAPTURE_Y4M) {
+        capture->video = fopen(path, "wb");
+        if (!capture->video) {
+            printf("Could not write %s\n", path);
+            return false;
+        }
+        fprintf(capture->video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+
+    gen_buffers(CAPTURE_BUFFERS, capture->buffers);
+    for (int i=0; i<CAPTURE_BUFFERS; i++) {
+        bind_buffer(GL_PIXEL_PACK_BUFFER, capture->buffers[i]);
+        buffer_data(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width*height*4, NULL, GL_STREAM_READ);
+        capture->fences[i] = NULL;
+        capture->numbers[i] = 0;
+    }
+    bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture->next = 0;
+    capture->frames = 0;
+
+    capture->todo.clear();
+    capture->spare.clear();
+    capture->quit = false;
+    capture->written = 0;
+    capture->stalls = 0;
+    capture->failed = false;
+    capture->encoder = std::thread(encoder_main, capture);
+    return true;
+}
+
+/* Maps buffer 'i', whose read was started CAPTURE_BUFFERS frames ago, and
+   queues its pixels for the encoder */
+static void collect(Capture * capture, int i)
+{
+    client_wait_sync((GLsync)capture->fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    delete_sync((GLsync)capture->fences[i]);
+    capture->fences[i] = NULL;
+
+    CaptureFrame * frame;
+    {
+        std::unique_lock<std::mutex> guard(capture->lock);
+        if (capture->todo.size() >= CAPTURE_QUEUE) {
+            capture->stalls++;
+            while (capture->todo.size() >= CAPTURE_QUEUE)
+                capture->space.wait(guard);
+        }
+        if (capture->spare.empty())
+            frame = new CaptureFrame;
+        else {
+            frame = capture->spare.back();
+            capture->spare.pop_back();
+        }
+    }
+
+    size_t size = (size_t)capture->width*capture->height*4;
+    frame->number = capture->numbers[i];
+    frame->pixels.resize(size);
+    bind_buffer(GL_PIXEL_PACK_BUFFER, capture->buffers[i]);
+    void * data = map_buffer_range(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data) {
+        memcpy(&frame->pixels[0], data, size);
+        unmap_buffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else
+        memset(&frame->pixels[0], 0, size);
+    bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    std::lock_guard<std::mutex> guard(capture->lock);
+    capture->todo.push_back(frame);
+    capture->wake.notify_one();
+}
+
+void capture_frame(Capture * capture)
+{
+    int i = capture->next;
+    if (capture->fences[i])
+        collect(capture, i);
+
+    // Into the buffer, so glReadPixels returns before the copy is done
+    bind_buffer(GL_PIXEL_PACK_BUFFER, capture->buffers[i]);
+    read_pixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture->fences[i] = fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture->numbers[i] = capture->frames++;
+    capture->next = (i + 1) % CAPTURE_BUFFERS;
+}
+
+bool capture_close(Capture * capture)
+{
+    // Oldest first, so the frames stay in order
+    for (int n=0; n<CAPTURE_BUFFERS; n++) {
+        int i = (capture->next + n) % CAPTURE_BUFFERS;
+        if (capture->fences[i])
+            collect(capture, i);
+    }
+    {
+        std::lock_guard<std::mutex> guard(capture->lock);
+        capture->quit = true;
+        capture->wake.notify_one();
+    }
+    capture->encoder.join();
+    delete_buffers(CAPTURE_BUFFERS, capture->buffers);
+
+    bool ok = !capture->failed;
+    if (capture->video) {
+        ok = fclose(capture->video) == 0 && ok;
+        capture->video = NULL;
+    }
+    for (size_t i=0; i<capture->spare.size(); i++)
+        delete capture->spare[i];
+    capture->spare.clear();
+    printf("Captured %u frames to %s, %u waited for the encoder\n", capture->written, capture->path.c_str(), capture->stalls);
+    return ok;
+}
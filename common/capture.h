@@ -0,0 +1,78 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* Records what the programs draw without stalling them on the read back.
+ *
+ * Each frame is read into one of a ring of pixel pack buffers, which GL
+ * fills in the background. A buffer is only mapped when the ring comes back
+ * round to it CAPTURE_BUFFERS frames later, when the copy has long finished.
+ * The pixels are then handed to an encoder thread that writes them out:
+ *
+ *   name.y4m   every frame into one uncompressed 4:2:0 YUV4MPEG2 video
+ *   name.png   a PNG per frame, name_00000.png, name_00001.png, ...
+ *
+ * The PNGs are written uncompressed (stored deflate blocks), which keeps the
+ * encoder far faster than the frame rate; they compress well afterwards.
+ */
+#define CAPTURE_BUFFERS 3       // frames between reading one and mapping it
+#define CAPTURE_QUEUE   8       // frames the encoder can fall behind by
+
+#define CAPTURE_PNG 0
+#define CAPTURE_Y4M 1
+
+/* Pixels of one frame, RGBA bottom row first as GL reads them */
+struct CaptureFrame {
+    uint32_t number;
+    std::vector<unsigned char> pixels;
+};
+
+struct Capture {
+    int format;
+    std::string path;
+    int width;
+    int height;
+    int fps;
+    FILE * video;                       // CAPTURE_Y4M, encoder thread only
+
+    unsigned int buffers[CAPTURE_BUFFERS];
+    void * fences[CAPTURE_BUFFERS];     // GLsync, set while a read is in flight
+    uint32_t numbers[CAPTURE_BUFFERS];  // frame each buffer holds
+    int next;                           // buffer the next frame goes into
+    uint32_t frames;                    // frames read so far
+
+    std::thread encoder;
+    std::mutex lock;
+    std::condition_variable wake;       // work for the encoder, or quit
+    std::condition_variable space;      // the encoder took a frame
+    std::deque<CaptureFrame *> todo;    // guarded by lock
+    std::vector<CaptureFrame *> spare;  // guarded by lock, reused by capture_frame
+    bool quit;                          // guarded by lock
+    uint32_t written;                   // guarded by lock
+    uint32_t stalls;                    // frames that waited for the encoder
+    bool failed;                        // guarded by lock, a write went wrong
+};
+
+/* Starts capturing width x height frames into 'path', which picks the
+   format by its extension. 'fps' only goes into the video header.
+   'get_proc' looks GL functions up in the current context */
+bool capture_open(Capture * capture, const char * path, int width, int height, int fps,
+                  void * (*get_proc)(const char * name));
+
+/* Reads the frame just drawn, from the bottom left of the read buffer.
+   Call it after drawing and before the swap */
+void capture_frame(Capture * capture);
+
+/* Reads back the frames still in flight, waits for the encoder to write
+   them all and closes the output. Needs the GL context still current */
+bool capture_close(Capture * capture);
+
+#endif
@@ -0,0 +1,120 @@
+#include "frame_sched.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <GL/glx.h>
+
+/* Sleeping any closer to a deadline than this tends to overshoot it */
+#define DEFAULT_SPIN 0.002
+
+void frame_sched_init(FrameSched * sched)
+{
+    sched->mode = FRAME_ON_DEMAND;
+    sched->fps = 60;
+    sched->spin = DEFAULT_SPIN;
+    sched->next_frame = 0;
+    sched->skip_unchanged = true;
+    sched->redraw = true;
+}
+
+bool frame_sched_parse(FrameSched * sched, const char * arg)
+{
+    if (strcmp(arg, "vsync") == 0)
+        sched->mode = FRAME_VSYNC;
+    else if (strcmp(arg, "demand") == 0)
+        sched->mode = FRAME_ON_DEMAND;
+    else {
+        char * end;
+        double fps = strtod(arg, &end);
+        if (*end != 0 || !(fps > 0))
+            return false;
+        sched->mode = FRAME_FIXED;
+        sched->fps = fps;
+    }
+    return true;
+}
+
+bool frame_sched_parse_redraw(FrameSched * sched, const char * arg)
+{
+    if (strcmp(arg, "changed") == 0)
+        sched->skip_unchanged = true;
+    else if (strcmp(arg, "always") == 0)
+        sched->skip_unchanged = false;
+    else
+        return false;
+    return true;
+}
+
+typedef int (*SwapIntervalProc)(int interval);
+
+void frame_sched_start(FrameSched * sched)
+{
+    // Only vsync lets the swap wait for the display, the others do their
+    // own waiting
+    int interval = sched->mode == FRAME_VSYNC ? 1 : 0;
+    SwapIntervalProc set = (SwapIntervalProc)glXGetProcAddressARB((const GLubyte *)"glXSwapIntervalMESA");
+    if (!set)
+        set = (SwapIntervalProc)glXGetProcAddressARB((const GLubyte *)"glXSwapIntervalSGI");
+    if (set && set(interval) == 0)
+        return;
+    if (sched->mode == FRAME_VSYNC) {
+        printf("Swap interval cannot be set, drawing at a fixed %g frames a second\n", sched->fps);
+        sched->mode = FRAME_FIXED;
+    }
+}
+
+double frame_sched_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* Sleeps until 'spin' before 'deadline', then spins the rest */
+static void wait_until(double deadline, double spin)
+{
+    double left = deadline - spin - frame_sched_now();
+    if (left > 0) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)left;
+        ts.tv_nsec = (long)((left - ts.tv_sec)*1e9);
+        nanosleep(&ts, NULL);
+    }
+    while (frame_sched_now() < deadline)
+        ;
+}
+
+bool frame_sched_wait(FrameSched * sched, double wake)
+{
+    // Nothing to show until the next step at the earliest, which does not
+    // need to land exactly
+    if (!sched->redraw && (sched->skip_unchanged || sched->mode == FRAME_ON_DEMAND)) {
+        wait_until(wake, 0);
+        return false;
+    }
+
+    if (sched->mode == FRAME_FIXED) {
+        double now = frame_sched_now();
+        // Start over rather than rushing out the frames a stall or a quiet
+        // spell missed
+        if (sched->next_frame == 0 || now > sched->next_frame + 1 / sched->fps)
+            sched->next_frame = now;
+        // A step due just before the frame waits for it, sleeping for the
+        // step could overshoot the frame
+        if (wake < sched->next_frame - sched->spin) {
+            wait_until(wake, 0);
+            return false;
+        }
+        wait_until(sched->next_frame, sched->spin);
+        sched->next_frame += 1 / sched->fps;
+    }
+    sched->redraw = false;
+    return true;
+}
+
+void frame_sched_request(FrameSched * sched)
+{
+    sched->redraw = true;
+}
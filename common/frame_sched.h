@@ -0,0 +1,53 @@
+#ifndef FRAME_SCHED_H
+#define FRAME_SCHED_H
+
+/* Decides when the GLUT programs draw, so they stop spinning a core when
+ * nothing is going on:
+ *
+ *   FRAME_VSYNC      draw every time round, the swap waits for the display
+ *   FRAME_FIXED      draw at 'fps', sleeping most of the wait and spinning
+ *                    only for the last 'spin' seconds, which sleep cannot
+ *                    hit precisely
+ *   FRAME_ON_DEMAND  draw as soon as frame_sched_request() is called, with
+ *                    no waiting for the display
+ *
+ * Unless 'skip_unchanged' is cleared, the first two also only draw after a
+ * request; a frame nothing asked for would be the same as the last one.
+ */
+#define FRAME_VSYNC     0
+#define FRAME_FIXED     1
+#define FRAME_ON_DEMAND 2
+
+struct FrameSched {
+    int mode;
+    double fps;
+    double spin;
+    double next_frame;      // FRAME_FIXED deadline, 0 before the first frame
+    bool skip_unchanged;
+    bool redraw;            // the scene changed since the last frame
+};
+
+/* On demand, falling back to 60 a second when a fixed rate is asked for */
+void frame_sched_init(FrameSched * sched);
+
+/* Mode from a --frame argument: "vsync", "demand" or a frame rate.
+   False if it is none of those */
+bool frame_sched_parse(FrameSched * sched, const char * arg);
+/* --redraw argument: "changed" or "always", the latter for timing draw() */
+bool frame_sched_parse_redraw(FrameSched * sched, const char * arg);
+
+/* Sets the swap interval the mode needs. Call once the GL context is
+   current. Without a way to set it vsync turns into a fixed 60 a second */
+void frame_sched_start(FrameSched * sched);
+
+/* Seconds on a monotonic clock */
+double frame_sched_now();
+
+/* Sleeps until a frame is due or until 'wake', whichever is first, and
+   returns true if a frame is due */
+bool frame_sched_wait(FrameSched * sched, double wake);
+
+/* The scene changed and needs drawing */
+void frame_sched_request(FrameSched * sched);
+
+#endif
@@ -0,0 +1,209 @@
+#include "input_log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+void input_log_init(InputLog * log)
+{
+    log->mode = INPUT_LOG_LIVE;
+    log->path.clear();
+    spsc_ring_init(&log->queue);
+    log->dropped = 0;
+    log->next_seq = 1;
+    log->events.clear();
+    log->next = 0;
+    log->end_tick = 0;
+}
+
+void input_log_record(InputLog * log, const char * path)
+{
+    input_log_init(log);
+    log->mode = INPUT_LOG_RECORD;
+    log->path = path;
+}
+
+static void put_varint(std::vector<unsigned char> & out, uint32_t value)
+{
+    while (value >= 0x80) {
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+static void put_signed(std::vector<unsigned char> & out, int32_t value)
+{
+    put_varint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static bool get_varint(const unsigned char ** in, const unsigned char * end, uint32_t * value)
+{
+    *value = 0;
+    for (int shift=0; shift<35; shift+=7) {
+        if (*in == end)
+            return false;
+        unsigned char byte = *(*in)++;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool get_signed(const unsigned char ** in, const unsigned char * end, int32_t * value)
+{
+    uint32_t raw;
+    if (!get_varint(in, end, &raw))
+        return false;
+    *value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+    return true;
+}
+
+bool input_log_replay(InputLog * log, const char * path)
+{
+    input_log_init(log);
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        printf("Input log %s could not be opened\n", path);
+        return false;
+    }
+    std::vector<unsigned char> bytes;
+    unsigned char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+
+    InputLogHeader header;
+    if (bytes.size() < sizeof(header)) {
+        printf("%s is not an input log\n", path);
+        return false;
+    }
+    memcpy(&header, &bytes[0], sizeof(header));
+    if (memcmp(header.magic, INPUT_LOG_MAGIC, 4) != 0 || header.version != INPUT_LOG_VERSION) {
+        printf("%s is not an input log\n", path);
+        return false;
+    }
+
+    const unsigned char * in = &bytes[0] + sizeof(header);
+    const unsigned char * end = &bytes[0] + bytes.size();
+    uint32_t tick = 0;
+    for (uint32_t i=0; i<header.count; i++) {
+        InputEvent event;
+        uint32_t delta;
+        bool ok = get_varint(&in, end, &delta) && in < end;
+        if (ok) {
+            event.type = *in++;
+            ok = get_signed(&in, end, &event.code) && get_signed(&in, end, &event.action) &&
+                 get_signed(&in, end, &event.mods) && get_signed(&in, end, &event.x) &&
+                 get_signed(&in, end, &event.y);
+        }
+        if (!ok) {
+            printf("Input log %s is truncated\n", path);
+            log->events.clear();
+            return false;
+        }
+        tick += delta;
+        event.tick = tick;
+        event.seq = i + 1;
+        event.time = 0;
+        log->events.push_back(event);
+    }
+
+    log->mode = INPUT_LOG_REPLAY;
+    log->path = path;
+    log->end_tick = header.end_tick;
+    return true;
+}
+
+static void queue_event(InputLog * log, int type, int code, int action, int mods, int x, int y, double time)
+{
+    if (log->mode == INPUT_LOG_REPLAY)
+        return;
+    InputEvent event;
+    event.tick = 0;             // stamped when it is applied
+    event.seq = log->next_seq++;
+    event.type = type;
+    event.code = code;
+    event.action = action;
+    event.mods = mods;
+    event.x = x;
+    event.y = y;
+    event.time = time;
+    if (!spsc_ring_push(&log->queue, event))
+        log->dropped++;
+}
+
+void input_log_push(InputLog * log, int type, int code, int action, int mods, int x, int y)
+{
+    // Same clock as sim_thread_now(), so it can be compared with step times
+    double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    queue_event(log, type, code, action, mods, x, y, now);
+}
+
+void input_log_inject(InputLog * log, int type, int code, int action)
+{
+    queue_event(log, type, code, action, 0, 0, 0, 0);
+}
+
+bool input_log_poll(InputLog * log, uint32_t tick, InputEvent * event)
+{
+    if (log->mode == INPUT_LOG_REPLAY) {
+        if (log->next == log->events.size() || log->events[log->next].tick > tick)
+            return false;
+        *event = log->events[log->next++];
+        return true;
+    }
+
+    if (!spsc_ring_pop(&log->queue, event))
+        return false;
+    event->tick = tick;
+    if (log->mode == INPUT_LOG_RECORD)
+        log->events.push_back(*event);
+    return true;
+}
+
+bool input_log_finished(const InputLog * log, uint32_t tick)
+{
+    return log->mode == INPUT_LOG_REPLAY && tick >= log->end_tick;
+}
+
+bool input_log_save(const InputLog * log, uint32_t end_tick)
+{
+    if (log->dropped > 0)
+        printf("%u input events were dropped, the simulation fell %d events behind\n",
+               log->dropped, INPUT_QUEUE_SIZE);
+    if (log->mode != INPUT_LOG_RECORD)
+        return true;
+
+    InputLogHeader header;
+    memcpy(header.magic, INPUT_LOG_MAGIC, 4);
+    header.version = INPUT_LOG_VERSION;
+    header.count = log->events.size();
+    header.end_tick = end_tick;
+    std::vector<unsigned char> bytes((unsigned char *)&header, (unsigned char *)(&header + 1));
+    uint32_t tick = 0;
+    for (size_t i=0; i<log->events.size(); i++) {
+        const InputEvent * event = &log->events[i];
+        put_varint(bytes, event->tick - tick);
+        tick = event->tick;
+        bytes.push_back(event->type);
+        put_signed(bytes, event->code);
+        put_signed(bytes, event->action);
+        put_signed(bytes, event->mods);
+        put_signed(bytes, event->x);
+        put_signed(bytes, event->y);
+    }
+
+    FILE * file = fopen(log->path.c_str(), "wb");
+    if (!file) {
+        printf("Could not write %s\n", log->path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        printf("Could not write %s\n", log->path.c_str());
+    return ok;
+}
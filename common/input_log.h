@@ -0,0 +1,102 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "spsc_ring.h"
+
+/* Window input stamped with the simulation tick it was applied on. Fed back
+ * in on the same ticks, a log reproduces a session exactly, which gives
+ * performance runs an identical workload every time.
+ *
+ * code, action and mods are whatever the window toolkit passed to the
+ * callback; a log is only meaningful to the program that recorded it.
+ */
+#define INPUT_KEY     1     // code is the key
+#define INPUT_SPECIAL 2     // GLUT special key
+#define INPUT_MOUSE   3     // code is the button
+
+struct InputEvent {
+    uint32_t tick;
+    uint32_t seq;               // counts up from 1 in the order events arrived
+    uint8_t type;
+    int32_t code;
+    int32_t action;
+    int32_t mods;
+    int32_t x;
+    int32_t y;
+    double time;                // when the callback ran, sim_thread_now() clock. Not saved
+};
+
+/* Log file: the header, then every event packed as
+ *
+ *   varint  ticks since the previous event
+ *   uint8   type
+ *   varint  code, action, mods, x, y   (zigzag, so small negatives stay small)
+ *
+ * A key press with no pointer position takes 7 bytes.
+ */
+#define INPUT_LOG_MAGIC "INPL"
+#define INPUT_LOG_VERSION 1
+
+struct InputLogHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t end_tick;          // ticks the session ran for
+};
+
+#define INPUT_LOG_LIVE   0
+#define INPUT_LOG_RECORD 1
+#define INPUT_LOG_REPLAY 2
+
+/* Events the window callbacks pushed that no step has taken yet. A step is
+   1/60 s, far more than this is never waiting */
+#define INPUT_QUEUE_SIZE 256
+
+struct InputLog {
+    int mode;
+    std::string path;
+    SpscRing<InputEvent, INPUT_QUEUE_SIZE> queue;   // window thread to simulation thread
+    uint32_t dropped;                   // pushed while the queue was full, window thread only
+    uint32_t next_seq;                  // window thread only
+    std::vector<InputEvent> events;     // recorded so far, or the replay
+    size_t next;
+    uint32_t end_tick;
+};
+
+/* Live input, nothing recorded */
+void input_log_init(InputLog * log);
+/* Live input, written to 'path' by input_log_save() */
+void input_log_record(InputLog * log, const char * path);
+/* Input read back from 'path', live input is dropped */
+bool input_log_replay(InputLog * log, const char * path);
+
+/* Called from the window callbacks, which must all run on one thread.
+   Stamps the event with the time it arrived. Ignored while replaying. Never
+   blocks; the event is dropped if the queue is full */
+void input_log_push(InputLog * log, int type, int code, int action, int mods, int x, int y);
+
+/* Queues input the program makes up, such as a command line option that
+   changes the starting state, so it is recorded and replayed like the
+   rest. It has no arrival time, so latency.h leaves it out. Same thread
+   as input_log_push, ignored while replaying */
+void input_log_inject(InputLog * log, int type, int code, int action);
+
+/* Next event to apply on 'tick', false once there are none left for it.
+   Call it until it returns false at the start of every tick, from one
+   thread only. Live events come out in the order they arrived */
+bool input_log_poll(InputLog * log, uint32_t tick, InputEvent * event);
+
+/* True when replaying and every tick of the recording has run */
+bool input_log_finished(const InputLog * log, uint32_t tick);
+
+/* Writes the recording of a session that ran for 'end_tick' ticks. Does
+   nothing else unless recording. In every mode it says how many events
+   were dropped on a full queue; the game never saw those, so they are not
+   in the recording either */
+bool input_log_save(const InputLog * log, uint32_t end_tick);
+
+#endif
@@ -0,0 +1,136 @@
+#include "latency.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static void histogram_add(LatencyHistogram * h, double seconds)
+{
+    double ms = seconds*1000;
+    if (ms < 0)
+        ms = 0;
+    int bucket = ms < LATENCY_BUCKETS - 1 ? (int)ms : LATENCY_BUCKETS - 1;
+    h->counts[bucket]++;
+    h->samples++;
+    h->sum += ms;
+    if (ms > h->max)
+        h->max = ms;
+}
+
+/* Upper edge, in ms, of the bucket holding the 'fraction' quantile */
+static int histogram_quantile(const LatencyHistogram * h, double fraction)
+{
+    uint32_t seen = 0;
+    for (int i=0; i<LATENCY_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > 0 && seen >= fraction*h->samples)
+            return i + 1;
+    }
+    return LATENCY_BUCKETS;
+}
+
+static void summarize(FILE * out, const char * prefix, const char * name, const LatencyHistogram * h)
+{
+    if (h->samples == 0) {
+        fprintf(out, "%s%s no samples\n", prefix, name);
+        return;
+    }
+    fprintf(out, "%s%s mean %.1f ms, p50 <%d ms, p99 <%d ms, max %.1f ms\n", prefix, name,
+            h->sum / h->samples, histogram_quantile(h, 0.5), histogram_quantile(h, 0.99), h->max);
+}
+
+void latency_init(LatencyLog * log)
+{
+    log->enabled = false;
+    log->path.clear();
+    spsc_ring_init(&log->applied);
+    log->has_next = false;
+    log->last_seq = 0;
+    memset(log->frames, 0, sizeof(log->frames));
+    memset(&log->to_swap, 0, sizeof(log->to_swap));
+    memset(&log->to_gpu, 0, sizeof(log->to_gpu));
+    log->lost = 0;
+}
+
+void latency_record(LatencyLog * log, const char * path)
+{
+    latency_init(log);
+    log->enabled = true;
+    log->path = path;
+}
+
+void latency_applied(LatencyLog * log, const InputEvent * event)
+{
+    if (!log->enabled || event->time == 0)
+        return;
+    LatencyApplied applied;
+    applied.seq = event->seq;
+    applied.arrival = event->time;
+    // 'lost' belongs to the render thread, a full ring shows up there as a
+    // gap in the seqs instead
+    spsc_ring_push(&log->applied, applied);
+}
+
+bool latency_swapped(LatencyLog * log, int frame, uint32_t seq, double time)
+{
+    if (!log->enabled)
+        return false;
+    LatencyFrame * f = &log->frames[frame];
+    f->count = 0;
+    while (log->has_next || spsc_ring_pop(&log->applied, &log->next)) {
+        log->has_next = true;
+        // Seqs count up, so the first one newer than the frame ends it
+        if ((int32_t)(log->next.seq - seq) > 0)
+            break;
+        log->has_next = false;
+        if (log->last_seq != 0 && log->next.seq - log->last_seq > 1)
+            log->lost += log->next.seq - log->last_seq - 1;
+        log->last_seq = log->next.seq;
+
+        histogram_add(&log->to_swap, time - log->next.arrival);
+        if (f->count < LATENCY_FRAME_EVENTS)
+            f->arrival[f->count++] = log->next.arrival;
+        else
+            log->lost++;
+    }
+    return f->count > 0;
+}
+
+void latency_completed(LatencyLog * log, int frame, double time)
+{
+    LatencyFrame * f = &log->frames[frame];
+    for (int i=0; i<f->count; i++)
+        histogram_add(&log->to_gpu, time - f->arrival[i]);
+    f->count = 0;
+}
+
+bool latency_save(const LatencyLog * log)
+{
+    if (!log->enabled)
+        return true;
+
+    printf("Input latency, %u events (%u not timed)\n", log->to_swap.samples, log->lost);
+    summarize(stdout, "  ", "to swap:", &log->to_swap);
+    summarize(stdout, "  ", "to gpu: ", &log->to_gpu);
+
+    FILE * file = fopen(log->path.c_str(), "w");
+    if (!file) {
+        printf("Could not write %s\n", log->path.c_str());
+        return false;
+    }
+    fprintf(file, "# input to photon latency, %u events (%u not timed)\n", log->to_swap.samples, log->lost);
+    summarize(file, "# ", "to swap:", &log->to_swap);
+    summarize(file, "# ", "to gpu: ", &log->to_gpu);
+    fprintf(file, "# ms\tswap\tgpu\n");
+    // Rows up to the slowest bucket used, the last row also counts slower ones
+    int rows = 0;
+    for (int i=0; i<LATENCY_BUCKETS; i++)
+        if (log->to_swap.counts[i] || log->to_gpu.counts[i])
+            rows = i + 1;
+    for (int i=0; i<rows; i++)
+        fprintf(file, "%d%s\t%u\t%u\n", i, i == LATENCY_BUCKETS - 1 ? "+" : "",
+                log->to_swap.counts[i], log->to_gpu.counts[i]);
+    bool ok = fclose(file) == 0;
+    if (!ok)
+        printf("Could not write %s\n", log->path.c_str());
+    return ok;
+}
@@ -0,0 +1,78 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <string>
+
+#include "input_log.h"
+#include "spsc_ring.h"
+
+/* Input to photon latency: for every input event, the time from the
+ * callback that received it to the first frame showing its effect, once when
+ * that frame's swap returned and once when the GPU finished it.
+ *
+ * The simulation thread reports each event it applies. Snapshots carry the
+ * seq of the newest event applied, and after a swap the render thread reports
+ * the seq its frame showed, which settles every event up to it. GPU
+ * completion comes from a fence the program puts in after the swap and polls
+ * each frame, so it is only as precise as the frame rate. The module makes no
+ * GL calls itself; the programs use different loaders.
+ */
+#define LATENCY_BUCKETS      100    // 1 ms each, the last one counts anything slower
+#define LATENCY_PENDING      256    // applied, not yet on screen
+#define LATENCY_FRAMES       4      // frames whose fence is still outstanding
+#define LATENCY_FRAME_EVENTS 32     // events first shown by one frame
+
+struct LatencyApplied {
+    uint32_t seq;
+    double arrival;
+};
+
+struct LatencyHistogram {
+    uint32_t counts[LATENCY_BUCKETS];
+    uint32_t samples;
+    double sum;
+    double max;
+};
+
+/* Arrival times of the events a frame showed first, kept until its fence */
+struct LatencyFrame {
+    int count;
+    double arrival[LATENCY_FRAME_EVENTS];
+};
+
+struct LatencyLog {
+    bool enabled;
+    std::string path;
+    SpscRing<LatencyApplied, LATENCY_PENDING> applied;  // simulation to render thread
+    LatencyApplied next;            // popped, but newer than the frames so far
+    bool has_next;
+    uint32_t last_seq;              // newest settled, gaps in the seqs were lost
+    LatencyFrame frames[LATENCY_FRAMES];
+    LatencyHistogram to_swap;
+    LatencyHistogram to_gpu;
+    uint32_t lost;                  // events that could not be timed
+};
+
+/* Nothing measured */
+void latency_init(LatencyLog * log);
+/* Measured, and written to 'path' by latency_save() */
+void latency_record(LatencyLog * log, const char * path);
+
+/* Simulation thread: 'event' was applied. Replayed events never arrived
+   and are ignored */
+void latency_applied(LatencyLog * log, const InputEvent * event);
+
+/* Render thread: the swap of a frame showing every event up to 'seq'
+   returned at 'time'. 'frame' picks one of the LATENCY_FRAMES slots for
+   its fence, and must not be one still waiting on latency_completed().
+   Returns true if the frame showed new events, and so needs a fence */
+bool latency_swapped(LatencyLog * log, int frame, uint32_t seq, double time);
+/* Render thread: the fence of 'frame' was found signalled at 'time' */
+void latency_completed(LatencyLog * log, int frame, double time);
+
+/* Writes the histograms, and prints a summary. Does nothing unless
+   measuring */
+bool latency_save(const LatencyLog * log);
+
+#endif
@@ -0,0 +1,224 @@
+#include "level.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Level files are used in place and are little endian"
+#endif
+
+static uint64_t align8(uint64_t value)
+{
+    return (value + 7) & ~(uint64_t)7;
+}
+
+/* True if [offset, offset + count*item) lies inside a file of 'size' bytes */
+static bool section_fits(uint64_t offset, uint64_t count, uint64_t item, uint64_t size)
+{
+    if (offset > size || (offset & 7) != 0)
+        return false;
+    return count <= (size - offset) / item;
+}
+
+bool level_from_memory(Level * level, const void * data, size_t size)
+{
+    memset(level, 0, sizeof(*level));
+
+    const unsigned char * base = (const unsigned char *)data;
+    if (size < sizeof(LevelHeader) || ((uintptr_t)base & 7) != 0)
+        return false;
+    const LevelHeader * header = (const LevelHeader *)base;
+    if (memcmp(header->magic, LEVEL_MAGIC, 4) != 0 || header->version != LEVEL_VERSION ||
+        header->header_size != sizeof(LevelHeader) || header->file_size != size)
+        return false;
+    if (header->width == 0 || header->depth == 0 || header->cell_size <= 0)
+        return false;
+    if (header->depth > UINT64_MAX / header->width)
+        return false;
+    if (!section_fits(header->row_index_offset, (uint64_t)header->depth + 1, sizeof(uint32_t), size) ||
+        !section_fits(header->run_end_offset, header->num_runs, sizeof(uint32_t), size) ||
+        !section_fits(header->run_tile_offset, header->num_runs, 1, size) ||
+        !section_fits(header->raw_row_offset, header->depth, sizeof(uint32_t), size) ||
+        !section_fits(header->raw_tile_offset, header->num_raw_rows, header->width, size))
+        return false;
+
+    TileRuns runs;
+    runs.width = header->width;
+    runs.depth = header->depth;
+    runs.num_runs = header->num_runs;
+    runs.row_index = (const uint32_t *)(base + header->row_index_offset);
+    runs.run_end = (const uint32_t *)(base + header->run_end_offset);
+    runs.run_tile = base + header->run_tile_offset;
+    runs.num_raw_rows = header->num_raw_rows;
+    runs.raw_row = (const uint32_t *)(base + header->raw_row_offset);
+    runs.raw_tile = base + header->raw_tile_offset;
+    // Lookups trust the runs, so check them once here
+    if (!tile_runs_valid(&runs))
+        return false;
+
+    level->header = header;
+    level->tiles = runs;
+    return true;
+}
+
+bool level_open(Level * level, const char * path)
+{
+    memset(level, 0, sizeof(*level));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Level %s could not be opened\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        printf("Level %s is empty\n", path);
+        return false;
+    }
+    void * map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("Level %s could not be mapped\n", path);
+        return false;
+    }
+
+    if (!level_from_memory(level, map, st.st_size)) {
+        printf("%s is not a valid level\n", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+    level->map = map;
+    level->map_size = st.st_size;
+    return true;
+}
+
+bool level_open_asset(Level * level, const AssetPack * pack, const char * name)
+{
+    AssetView view;
+    if (!asset_pack_find(pack, name, &view))
+        return level_open(level, name);
+    if (!level_from_memory(level, view.data, view.size)) {
+        printf("%s in the asset pack is not a valid level\n", name);
+        return false;
+    }
+    return true;
+}
+
+void level_close(Level * level)
+{
+    if (level->map)
+        munmap(level->map, level->map_size);
+    memset(level, 0, sizeof(*level));
+}
+
+bool level_cell(const Level * level, int x, int z, int * cx, int * cz)
+{
+    const LevelHeader * h = level->header;
+    long dx = (long)x - h->origin_x;
+    long dz = (long)z - h->origin_z;
+    if (dx < 0 || dz < 0)
+        return false;
+    dx /= h->cell_size;
+    dz /= h->cell_size;
+    if (dx >= (long)h->width || dz >= (long)h->depth)
+        return false;
+    *cx = dx;
+    *cz = dz;
+    return true;
+}
+
+void level_desc_init(LevelDesc * desc, int width, int depth, int origin_x, int origin_z, int cell_size)
+{
+    desc->width = width;
+    desc->depth = depth;
+    desc->origin_x = origin_x;
+    desc->origin_z = origin_z;
+    desc->cell_size = cell_size;
+    desc->spawn.x = origin_x;
+    desc->spawn.z = origin_z;
+    desc->goal.x = origin_x + (width - 1)*cell_size;
+    desc->goal.z = origin_z + (depth - 1)*cell_size;
+    desc->tiles.assign((size_t)width*depth, TILE_FLOOR);
+}
+
+bool level_desc_mark(LevelDesc * desc, int x, int z, int flags)
+{
+    long dx = (long)x - desc->origin_x;
+    long dz = (long)z - desc->origin_z;
+    if (dx < 0 || dz < 0 || dx % desc->cell_size != 0 || dz % desc->cell_size != 0)
+        return false;
+    dx /= desc->cell_size;
+    dz /= desc->cell_size;
+    if (dx >= desc->width || dz >= desc->depth)
+        return false;
+    desc->tiles[(size_t)dz*desc->width + dx] |= flags;
+    return true;
+}
+
+void level_serialize(const LevelDesc * desc, std::vector<unsigned char> & out)
+{
+    uint32_t holes = 0, obstacles = 0;
+    for (size_t i=0; i<desc->tiles.size(); i++) {
+        holes += (desc->tiles[i] & TILE_HOLE) != 0;
+        obstacles += (desc->tiles[i] & TILE_OBSTACLE) != 0;
+    }
+    TileRunsData runs;
+    tile_runs_encode(&desc->tiles[0], desc->width, desc->depth, &runs);
+
+    LevelHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEVEL_MAGIC, 4);
+    header.version = LEVEL_VERSION;
+    header.header_size = sizeof(LevelHeader);
+    header.width = desc->width;
+    header.depth = desc->depth;
+    header.origin_x = desc->origin_x;
+    header.origin_z = desc->origin_z;
+    header.cell_size = desc->cell_size;
+    header.num_holes = holes;
+    header.num_obstacles = obstacles;
+    header.num_runs = runs.run_end.size();
+    header.num_raw_rows = runs.raw_tile.size() / desc->width;
+    header.spawn = desc->spawn;
+    header.goal = desc->goal;
+    header.row_index_offset = sizeof(LevelHeader);
+    header.run_end_offset = align8(header.row_index_offset + runs.row_index.size()*sizeof(uint32_t));
+    header.run_tile_offset = align8(header.run_end_offset + runs.run_end.size()*sizeof(uint32_t));
+    header.raw_row_offset = align8(header.run_tile_offset + runs.run_tile.size());
+    header.raw_tile_offset = align8(header.raw_row_offset + runs.raw_row.size()*sizeof(uint32_t));
+    header.file_size = header.raw_tile_offset + runs.raw_tile.size();
+
+    out.assign(header.file_size, 0);
+    memcpy(&out[0], &header, sizeof(header));
+    memcpy(&out[header.row_index_offset], &runs.row_index[0], runs.row_index.size()*sizeof(uint32_t));
+    // Every row may be raw, leaving no runs at all
+    if (!runs.run_end.empty()) {
+        memcpy(&out[header.run_end_offset], &runs.run_end[0], runs.run_end.size()*sizeof(uint32_t));
+        memcpy(&out[header.run_tile_offset], &runs.run_tile[0], runs.run_tile.size());
+    }
+    memcpy(&out[header.raw_row_offset], &runs.raw_row[0], runs.raw_row.size()*sizeof(uint32_t));
+    if (!runs.raw_tile.empty())
+        memcpy(&out[header.raw_tile_offset], &runs.raw_tile[0], runs.raw_tile.size());
+}
+
+bool level_write(const LevelDesc * desc, const char * path)
+{
+    std::vector<unsigned char> bytes;
+    level_serialize(desc, bytes);
+
+    FILE * file = fopen(path, "wb");
+    if (!file) {
+        printf("Could not write %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        printf("Could not write %s\n", path);
+    return ok;
+}
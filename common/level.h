@@ -0,0 +1,107 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "asset_pack.h"
+#include "tile_rle.h"
+
+/* Binary block world level, version 3. Everything is little endian and every
+ * section starts on an 8 byte boundary, so a mapped file is used in place:
+ *
+ *   LevelHeader
+ *   uint32_t row_index[depth + 1]      tiles, run length encoded by row
+ *   uint32_t run_end[num_runs]         (see tile_rle.h)
+ *   uint8_t  run_tile[num_runs]
+ *   uint32_t raw_row[depth]            rows left as a byte per cell
+ *   uint8_t  raw_tile[num_raw_rows * width]
+ *
+ * Cell (cx, cz) sits at world position origin + cell_size * (cx, cz).
+ * Version 1 stored a byte per tile plus lists of the hole and obstacle
+ * positions. Large levels that are mostly plain floor take a small fraction
+ * of that as runs. A row busy enough that its runs would be bigger is kept
+ * as bytes, so a dense level costs about the same as version 1. Version 2
+ * had no raw rows.
+ */
+#define LEVEL_MAGIC "BLVL"
+#define LEVEL_VERSION 3
+
+/* Low four bits of a tile are flags, the high four pick its material */
+#define TILE_FLOOR      0x00
+#define TILE_HOLE       0x01
+#define TILE_OBSTACLE   0x02
+#define TILE_FLAGS      0x0F
+#define TILE_MATERIAL_SHIFT 4
+
+struct LevelPoint {
+    int32_t x;
+    int32_t z;
+};
+
+struct LevelHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t width;
+    uint32_t depth;
+    int32_t origin_x;
+    int32_t origin_z;
+    int32_t cell_size;
+    uint32_t num_holes;         // tiles flagged TILE_HOLE
+    uint32_t num_obstacles;     // tiles flagged TILE_OBSTACLE
+    uint32_t num_runs;
+    uint32_t num_raw_rows;
+    uint32_t reserved;          // zero
+    LevelPoint spawn;
+    LevelPoint goal;
+    uint64_t row_index_offset;
+    uint64_t run_end_offset;
+    uint64_t run_tile_offset;
+    uint64_t raw_row_offset;
+    uint64_t raw_tile_offset;
+    uint64_t file_size;
+};
+
+/* A validated level. The pointers alias the file mapping (or the buffer it was
+   opened from), nothing is copied */
+struct Level {
+    const LevelHeader * header;
+    TileRuns tiles;
+    void * map;
+    size_t map_size;
+};
+
+bool level_open(Level * level, const char * path);
+/* Uses 'name' out of the asset pack if it is there, maps the file otherwise */
+bool level_open_asset(Level * level, const AssetPack * pack, const char * name);
+/* Validates a level image that stays owned by the caller */
+bool level_from_memory(Level * level, const void * data, size_t size);
+void level_close(Level * level);
+
+/* Cell coordinates of a world position. Returns false outside the grid */
+bool level_cell(const Level * level, int x, int z, int * cx, int * cz);
+
+/* Editable level used by the converter and generators */
+struct LevelDesc {
+    int width;
+    int depth;
+    int origin_x;
+    int origin_z;
+    int cell_size;
+    LevelPoint spawn;
+    LevelPoint goal;
+    std::vector<uint8_t> tiles;
+};
+
+void level_desc_init(LevelDesc * desc, int width, int depth, int origin_x, int origin_z, int cell_size);
+/* ORs 'flags' into the tile at world position (x, z). False if off the grid */
+bool level_desc_mark(LevelDesc * desc, int x, int z, int flags);
+
+/* Lays the level out in the binary format, run length encoding the tiles
+   of every row that gets smaller for it */
+void level_serialize(const LevelDesc * desc, std::vector<unsigned char> & out);
+bool level_write(const LevelDesc * desc, const char * path);
+
+#endif
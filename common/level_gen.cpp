@@ -0,0 +1,149 @@
+#include "level_gen.h"
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+/* Rows per band. Part of the output, changing it changes every level */
+#define BAND_ROWS 64
+
+/* Set on cells of the carved path while generating, cleared before returning */
+#define TILE_PATH 0x08
+
+static uint64_t splitmix64(uint64_t * state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Small fast generator for the per-cell rolls (xorshift64*) */
+struct Rng {
+    uint64_t state;
+};
+
+static void rng_seed(Rng * rng, uint64_t seed, uint64_t stream)
+{
+    uint64_t s = seed ^ (stream * 0xD1B54A32D192ED03ull);
+    rng->state = splitmix64(&s) | 1;
+}
+
+static uint32_t rng_next(Rng * rng)
+{
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (rng->state * 0x2545F4914F6CDD1Dull) >> 32;
+}
+
+/* Probability as a 32 bit threshold so a roll is one compare */
+static uint64_t threshold(float p)
+{
+    if (p <= 0)
+        return 0;
+    if (p >= 1)
+        return 1ull << 32;
+    return (uint64_t)(p * 4294967296.0);
+}
+
+/* Monotone random walk from (0, 0) to the far corner. Every step moves one
+   cell along x or z, so the goal is always reachable by the player's moves */
+static void carve_path(LevelDesc * desc, uint64_t seed)
+{
+    Rng rng;
+    rng_seed(&rng, seed, ~0ull);
+    int cx = 0, cz = 0;
+    desc->tiles[0] |= TILE_PATH;
+    while (cx < desc->width - 1 || cz < desc->depth - 1) {
+        int left_x = desc->width - 1 - cx, left_z = desc->depth - 1 - cz;
+        // Step along x with probability proportional to the distance left,
+        // which keeps the walk near the diagonal instead of hugging an edge
+        if (left_z == 0 || (left_x > 0 && (uint64_t)rng_next(&rng) * (left_x + left_z) < (uint64_t)left_x << 32))
+            cx++;
+        else
+            cz++;
+        desc->tiles[(size_t)cz*desc->width + cx] |= TILE_PATH;
+    }
+}
+
+static void fill_band(LevelDesc * desc, const LevelGenParams * params, int band,
+                      uint64_t hole_limit, uint64_t block_limit)
+{
+    Rng rng;
+    rng_seed(&rng, params->seed, band);
+    int first = band*BAND_ROWS;
+    int last = min(first + BAND_ROWS, desc->depth);
+    for (int cz=first; cz<last; cz++) {
+        uint8_t * row = &desc->tiles[(size_t)cz*desc->width];
+        for (int cx=0; cx<desc->width; cx++) {
+            // Roll for every cell, path or not, so the stream does not
+            // depend on where the path went
+            uint64_t roll = rng_next(&rng);
+            uint32_t material = params->materials ? rng_next(&rng) >> 28 : 0;
+            if (row[cx] & TILE_PATH) {
+                row[cx] = material << TILE_MATERIAL_SHIFT;
+                continue;
+            }
+            uint8_t tile = material << TILE_MATERIAL_SHIFT;
+            if (roll < hole_limit)
+                tile |= TILE_HOLE;
+            else if (roll < hole_limit + block_limit)
+                tile |= TILE_OBSTACLE;
+            row[cx] = tile;
+        }
+    }
+}
+
+void level_gen_defaults(LevelGenParams * params)
+{
+    params->width = 11;
+    params->depth = 11;
+    params->cell_size = 2;
+    params->seed = 1;
+    params->hole_density = 0.15f;
+    params->obstacle_density = 0.05f;
+    params->materials = false;
+    params->threads = 0;
+}
+
+bool level_generate(LevelDesc * desc, const LevelGenParams * params)
+{
+    if (params->width <= 0 || params->depth <= 0 || params->cell_size <= 0) {
+        printf("Level size must be positive\n");
+        return false;
+    }
+    if (params->hole_density < 0 || params->obstacle_density < 0 ||
+        params->hole_density + params->obstacle_density > 1) {
+        printf("Hole and obstacle densities must add up to at most 1\n");
+        return false;
+    }
+
+    // Centre the grid on the origin, like the hand made levels
+    int origin_x = -(params->width - 1)/2*params->cell_size;
+    int origin_z = -(params->depth - 1)/2*params->cell_size;
+    level_desc_init(desc, params->width, params->depth, origin_x, origin_z, params->cell_size);
+    carve_path(desc, params->seed);
+
+    uint64_t hole_limit = threshold(params->hole_density);
+    uint64_t block_limit = threshold(params->obstacle_density);
+    int bands = (desc->depth + BAND_ROWS - 1) / BAND_ROWS;
+    int threads = params->threads > 0 ? params->threads : (int)thread::hardware_concurrency();
+    threads = max(1, min(threads, bands));
+
+    atomic<int> next_band(0);
+    vector<thread> workers;
+    for (int t=1; t<threads; t++)
+        workers.push_back(thread([&]() {
+            for (int band; (band = next_band++) < bands; )
+                fill_band(desc, params, band, hole_limit, block_limit);
+        }));
+    for (int band; (band = next_band++) < bands; )
+        fill_band(desc, params, band, hole_limit, block_limit);
+    for (size_t t=0; t<workers.size(); t++)
+        workers[t].join();
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef LEVEL_GEN_H
+#define LEVEL_GEN_H
+
+#include <stdint.h>
+
+#include "level.h"
+
+/* Settings for a generated level. The grid is centred on the world origin
+   with the same cell size the block world uses */
+struct LevelGenParams {
+    int width;
+    int depth;
+    int cell_size;
+    uint64_t seed;
+    float hole_density;         // chance a cell off the path is a hole
+    float obstacle_density;     // chance a cell off the path gets a block
+    bool materials;             // random tile materials, off leaves plain floor
+    int threads;                // 0 picks one per core
+};
+
+void level_gen_defaults(LevelGenParams * params);
+
+/* Fills 'desc' with a random level. Spawn and goal sit in opposite corners
+ * and a walkable path between them is carved before anything else is placed.
+ *
+ * Rows are generated in fixed size bands, each from its own random stream
+ * seeded from (seed, band), and the bands are shared out between threads.
+ * The same seed gives the same level whatever the thread count.
+ */
+bool level_generate(LevelDesc * desc, const LevelGenParams * params);
+
+#endif
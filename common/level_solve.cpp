@@ -0,0 +1,56 @@
+#include "level_solve.h"
+
+static bool walkable(const uint8_t * tiles, uint32_t index)
+{
+    return (tiles[index] & (TILE_HOLE | TILE_OBSTACLE)) == 0;
+}
+
+int level_solve(LevelSolver * solver, const Level * level)
+{
+    const LevelHeader * h = level->header;
+    int sx, sz, gx, gz;
+    if (!level_cell(level, h->spawn.x, h->spawn.z, &sx, &sz) ||
+        !level_cell(level, h->goal.x, h->goal.z, &gx, &gz))
+        return LEVEL_UNREACHABLE;
+
+    uint32_t width = h->width, depth = h->depth;
+    uint32_t start = sz*width + sx, goal = gz*width + gx;
+
+    // The search touches cells in no particular order, so expand the runs
+    // once rather than searching a row for every neighbour
+    size_t cells = (size_t)width*depth;
+    solver->tiles.resize(cells);
+    const uint8_t * tiles = &solver->tiles[0];
+    for (uint32_t cz=0; cz<depth; cz++)
+        tile_runs_decode_row(&level->tiles, cz, &solver->tiles[(size_t)cz*width]);
+    if (!walkable(tiles, start) || !walkable(tiles, goal))
+        return LEVEL_UNREACHABLE;
+
+    // Each cell is queued at most once, so a flat array serves as the queue
+    solver->dist.assign(cells, -1);
+    solver->queue.resize(cells);
+    int32_t * dist = &solver->dist[0];
+    uint32_t * queue = &solver->queue[0];
+
+    size_t head = 0, tail = 0;
+    dist[start] = 0;
+    queue[tail++] = start;
+    while (head < tail) {
+        uint32_t cell = queue[head++];
+        if (cell == goal)
+            return dist[cell];
+        uint32_t cx = cell % width, cz = cell / width;
+        uint32_t next[4];
+        int count = 0;
+        if (cx > 0)         next[count++] = cell - 1;
+        if (cx + 1 < width) next[count++] = cell + 1;
+        if (cz > 0)         next[count++] = cell - width;
+        if (cz + 1 < depth) next[count++] = cell + width;
+        for (int i=0; i<count; i++)
+            if (dist[next[i]] < 0 && walkable(tiles, next[i])) {
+                dist[next[i]] = dist[cell] + 1;
+                queue[tail++] = next[i];
+            }
+    }
+    return LEVEL_UNREACHABLE;
+}
@@ -0,0 +1,26 @@
+#ifndef LEVEL_SOLVE_H
+#define LEVEL_SOLVE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "level.h"
+
+/* Scratch space for level_solve. Keep one per thread and reuse it, so
+   checking a batch of levels does not allocate per level */
+struct LevelSolver {
+    std::vector<int32_t> dist;
+    std::vector<uint32_t> queue;
+    std::vector<uint8_t> tiles;     // the level's runs expanded
+};
+
+#define LEVEL_UNREACHABLE -1
+
+/* Fewest moves from spawn to goal, or LEVEL_UNREACHABLE. A move is one cell
+ * along x or z, the same step the player takes, and only floor tiles
+ * without an obstacle can be stood on. A blocked or off-grid spawn or goal
+ * counts as unreachable.
+ */
+int level_solve(LevelSolver * solver, const Level * level);
+
+#endif
@@ -0,0 +1,236 @@
+#include "level_stream.h"
+
+#include <stdlib.h>
+#include <algorithm>
+
+using namespace std;
+
+/* Distance between stacked cubes, the size of the cube model */
+#define LAYER_HEIGHT 2.0f
+
+static int64_t region_key(const LevelStream * stream, int rx, int rz)
+{
+    return (int64_t)rz*stream->regions_x + rx;
+}
+
+static void add_cube(const LevelStreamConfig & config, StreamRegion * region, float x, float y, float z)
+{
+    int cube = config.cube_vertices.size() / 3;
+    for (int v=0; v<cube; v++) {
+        region->vertices.push_back(config.cube_vertices[3*v] + x);
+        region->vertices.push_back(config.cube_vertices[3*v + 1] + y);
+        region->vertices.push_back(config.cube_vertices[3*v + 2] + z);
+    }
+    region->colors.insert(region->colors.end(), config.cube_colors.begin(), config.cube_colors.end());
+}
+
+static void build_region(const LevelStream * stream, StreamRegion * region)
+{
+    const LevelStreamConfig & config = stream->config;
+    const LevelHeader * h = stream->level->header;
+    const TileRuns * runs = &stream->level->tiles;
+    uint32_t first_x = region->rx*config.region_cells, first_z = region->rz*config.region_cells;
+    uint32_t last_x = min(first_x + config.region_cells, h->width);
+    uint32_t last_z = min(first_z + config.region_cells, h->depth);
+
+    region->vertices.reserve((size_t)(last_x - first_x)*(last_z - first_z)*config.layers*config.cube_vertices.size());
+    region->colors.reserve(region->vertices.capacity());
+    for (uint32_t cz=first_z; cz<last_z; cz++) {
+        float z = h->origin_z + (int)cz*h->cell_size;
+        // Walk the spans overlapping this region's slice of the row
+        TileRowWalk walk;
+        TileSpan span;
+        tile_row_begin(&walk, runs, first_x, cz);
+        while (tile_row_next(&walk, &span) && span.start < last_x) {
+            uint32_t end = min(span.end, last_x);
+            uint8_t tile = span.tile;
+            for (uint32_t cx=span.start; cx<end; cx++) {
+                float x = h->origin_x + (int)cx*h->cell_size;
+                // A hole only takes away the top tile, the column under it stays
+                for (int layer=(tile & TILE_HOLE) ? 1 : 0; layer<config.layers; layer++)
+                    add_cube(config, region, x, config.floor_y - layer*LAYER_HEIGHT, z);
+                if (tile & TILE_OBSTACLE)
+                    add_cube(config, region, x, config.floor_y + LAYER_HEIGHT, z);
+            }
+        }
+    }
+    region->num_vertices = region->vertices.size() / 3;
+}
+
+static void worker_main(LevelStream * stream)
+{
+    unique_lock<mutex> guard(stream->lock);
+    for (;;) {
+        while (!stream->quit && stream->todo.empty())
+            stream->wake.wait(guard);
+        if (stream->quit)
+            return;
+        StreamRegion * region = stream->todo.front();
+        stream->todo.pop_front();
+        bool skip = region->cancelled;
+        guard.unlock();
+        if (!skip)
+            build_region(stream, region);
+        guard.lock();
+        stream->done.push_back(region);
+    }
+}
+
+void level_stream_defaults(LevelStreamConfig * config)
+{
+    config->region_cells = 16;
+    config->radius = 24;
+    config->uploads_per_frame = 2;
+    config->floor_y = 0;
+    config->layers = 1;
+    config->cube_vertices.clear();
+    config->cube_colors.clear();
+}
+
+void level_stream_start(LevelStream * stream, const Level * level, const LevelStreamConfig * config)
+{
+    stream->level = level;
+    stream->config = *config;
+    stream->config.region_cells = max(1, config->region_cells);
+    stream->config.uploads_per_frame = max(1, config->uploads_per_frame);
+    stream->regions_x = (level->header->width + stream->config.region_cells - 1) / stream->config.region_cells;
+    stream->regions_z = (level->header->depth + stream->config.region_cells - 1) / stream->config.region_cells;
+    stream->quit = false;
+    stream->worker = thread(worker_main, stream);
+}
+
+struct Wanted {
+    int rx, rz;
+    int64_t distance;
+};
+
+static bool nearer(const Wanted & a, const Wanted & b)
+{
+    return a.distance < b.distance;
+}
+
+void level_stream_update(LevelStream * stream, int x, int z,
+                         vector<StreamRegion *> & upload, vector<StreamRegion *> & release)
+{
+    const LevelStreamConfig & config = stream->config;
+    const LevelHeader * h = stream->level->header;
+    int size = config.region_cells;
+
+    // Player position in cells. Off the grid it is clamped, so walking off
+    // the edge keeps the border loaded rather than emptying the window
+    long px = ((long)x - h->origin_x) / h->cell_size;
+    long pz = ((long)z - h->origin_z) / h->cell_size;
+    px = max(0L, min(px, (long)h->width - 1));
+    pz = max(0L, min(pz, (long)h->depth - 1));
+
+    // Regions touching the square of 'radius' cells around the player are
+    // wanted; they are only dropped a region further out so that walking
+    // back and forth over a border does not rebuild the same mesh
+    int min_rx = max(0L, (px - config.radius) / size), max_rx = min((long)stream->regions_x - 1, (px + config.radius) / size);
+    int min_rz = max(0L, (pz - config.radius) / size), max_rz = min((long)stream->regions_z - 1, (pz + config.radius) / size);
+
+    vector<Wanted> wanted;
+    for (int rz=min_rz; rz<=max_rz; rz++)
+        for (int rx=min_rx; rx<=max_rx; rx++)
+            if (stream->regions.find(region_key(stream, rx, rz)) == stream->regions.end()) {
+                long dx = rx*size + size/2 - px, dz = rz*size + size/2 - pz;
+                Wanted w = {rx, rz, dx*dx + dz*dz};
+                wanted.push_back(w);
+            }
+    sort(wanted.begin(), wanted.end(), nearer);
+
+    vector<StreamRegion *> finished;
+    {
+        lock_guard<mutex> guard(stream->lock);
+        for (map<int64_t, StreamRegion *>::iterator it = stream->regions.begin(); it != stream->regions.end(); ) {
+            StreamRegion * region = it->second;
+            if (region->rx >= min_rx - 1 && region->rx <= max_rx + 1 &&
+                region->rz >= min_rz - 1 && region->rz <= max_rz + 1) {
+                ++it;
+                continue;
+            }
+            // Queued and built regions are freed once they come back round
+            if (region->state == REGION_RESIDENT)
+                release.push_back(region);
+            else
+                region->cancelled = true;
+            stream->regions.erase(it++);
+        }
+        for (size_t i=0; i<wanted.size(); i++) {
+            StreamRegion * region = new StreamRegion;
+            region->rx = wanted[i].rx;
+            region->rz = wanted[i].rz;
+            region->state = REGION_QUEUED;
+            region->cancelled = false;
+            region->num_vertices = 0;
+            region->mesh = NULL;
+            stream->regions[region_key(stream, region->rx, region->rz)] = region;
+            stream->todo.push_back(region);
+        }
+        finished.swap(stream->done);
+    }
+    if (!wanted.empty())
+        stream->wake.notify_one();
+
+    for (size_t i=0; i<finished.size(); i++) {
+        finished[i]->state = REGION_BUILT;
+        stream->built.push_back(finished[i]);
+    }
+    while (!stream->built.empty() && (int)upload.size() < config.uploads_per_frame) {
+        StreamRegion * region = stream->built.front();
+        stream->built.pop_front();
+        if (region->cancelled)
+            delete region;
+        else
+            upload.push_back(region);
+    }
+}
+
+void level_stream_uploaded(StreamRegion * region)
+{
+    region->state = REGION_RESIDENT;
+    vector<float>().swap(region->vertices);
+    vector<float>().swap(region->colors);
+}
+
+bool level_stream_settled(const LevelStream * stream)
+{
+    for (map<int64_t, StreamRegion *>::const_iterator it = stream->regions.begin(); it != stream->regions.end(); ++it)
+        if (it->second->state != REGION_RESIDENT)
+            return false;
+    return true;
+}
+
+void level_stream_stop(LevelStream * stream, vector<StreamRegion *> & release)
+{
+    if (!stream->worker.joinable())
+        return;
+    {
+        lock_guard<mutex> guard(stream->lock);
+        stream->quit = true;
+    }
+    stream->wake.notify_one();
+    stream->worker.join();
+
+    // Everything not on the GPU is owned here; cancelled regions are no
+    // longer in the map, but are still on one of the queues
+    for (size_t i=0; i<stream->todo.size(); i++)
+        if (stream->todo[i]->cancelled)
+            delete stream->todo[i];
+    for (size_t i=0; i<stream->done.size(); i++)
+        if (stream->done[i]->cancelled)
+            delete stream->done[i];
+    for (size_t i=0; i<stream->built.size(); i++)
+        if (stream->built[i]->cancelled)
+            delete stream->built[i];
+    for (map<int64_t, StreamRegion *>::iterator it = stream->regions.begin(); it != stream->regions.end(); ++it) {
+        if (it->second->state == REGION_RESIDENT)
+            release.push_back(it->second);
+        else
+            delete it->second;
+    }
+    stream->todo.clear();
+    stream->done.clear();
+    stream->built.clear();
+    stream->regions.clear();
+}
@@ -0,0 +1,84 @@
+#ifndef LEVEL_STREAM_H
+#define LEVEL_STREAM_H
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "level.h"
+
+/* How the floor around the player is streamed and what it looks like */
+struct LevelStreamConfig {
+    int region_cells;           // cells along each side of a region
+    int radius;                 // cells kept resident around the player
+    int uploads_per_frame;      // meshes handed to GL per update, caps the hitch
+    float floor_y;              // centre height of the tile the player stands on,
+                                // obstacles sit one cube higher
+    int layers;                 // cubes stacked under each tile, counting the top one
+    std::vector<float> cube_vertices;   // one cube, 3 floats per vertex
+    std::vector<float> cube_colors;     // 3 floats per vertex
+};
+
+enum {
+    REGION_QUEUED,              // waiting for, or on, the worker
+    REGION_BUILT,               // mesh ready to upload
+    REGION_RESIDENT             // uploaded, 'mesh' is set
+};
+
+/* A square of the level meshed as one vertex buffer */
+struct StreamRegion {
+    int rx;
+    int rz;
+    int state;
+    bool cancelled;             // left the window before it was uploaded
+    std::vector<float> vertices;
+    std::vector<float> colors;
+    int num_vertices;
+    void * mesh;                // the program's GPU object for the region
+};
+
+/* Keeps the regions within 'radius' of the player resident. The worker
+ * thread builds meshes straight from the mapped level, so only the parts of
+ * the file that are near the player get paged in, and the render thread
+ * only uploads and frees GPU objects.
+ */
+struct LevelStream {
+    const Level * level;
+    LevelStreamConfig config;
+    int regions_x;
+    int regions_z;
+    std::map<int64_t, StreamRegion *> regions;  // render thread only
+    std::deque<StreamRegion *> built;           // render thread only
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<StreamRegion *> todo;            // guarded by lock
+    std::vector<StreamRegion *> done;           // guarded by lock
+    bool quit;                                  // guarded by lock
+};
+
+void level_stream_defaults(LevelStreamConfig * config);
+void level_stream_start(LevelStream * stream, const Level * level, const LevelStreamConfig * config);
+
+/* Render thread, once a frame. Moves the window to world position (x, z).
+ * 'upload' gets regions whose meshes are ready: create the GPU object, set
+ * 'mesh' and call level_stream_uploaded. 'release' gets resident regions
+ * that fell out of range: free the GPU object, then delete the region.
+ */
+void level_stream_update(LevelStream * stream, int x, int z,
+                         std::vector<StreamRegion *> & upload, std::vector<StreamRegion *> & release);
+/* Drops the CPU copy of the mesh once it is on the GPU */
+void level_stream_uploaded(StreamRegion * region);
+/* True once every region in range is resident. Until then the program has
+   to keep calling level_stream_update to pick up the rest */
+bool level_stream_settled(const LevelStream * stream);
+
+/* Joins the worker. Resident regions are handed back through 'release' */
+void level_stream_stop(LevelStream * stream, std::vector<StreamRegion *> & release);
+
+#endif
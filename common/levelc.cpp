@@ -0,0 +1,165 @@
+/* Compiles a text level description into the binary level format.
+ *
+ *   usage: levelc in.txt out.lvl     compile
+ *          levelc -d in.lvl          print a binary level back as text
+ *
+ * Text format, one directive per line, '#' starts a comment. Positions are
+ * world coordinates, the same numbers the game uses for pos_x / pos_z:
+ *
+ *   size 11 11          cells along x and z (required, before any tiles)
+ *   origin -10 -10      world position of the first cell (default 0 0)
+ *   cell 2              distance between cells (default 1)
+ *   spawn -10 -10       where a new player appears (default: first cell)
+ *   goal 10 10          cell the player is trying to reach (default: last cell)
+ *   hole 2 -2           missing floor tile
+ *   obstacle 2 2        block standing on the floor
+ *   material 4 6 3      material (0-15) of the tile at 4 6
+ */
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "level.h"
+
+using namespace std;
+
+static int fail(const char * path, int line, const char * message)
+{
+    printf("%s:%d: %s\n", path, line, message);
+    return 1;
+}
+
+static int compile(const char * in_path, const char * out_path)
+{
+    FILE * in = fopen(in_path, "r");
+    if (!in) {
+        printf("Could not open %s\n", in_path);
+        return 1;
+    }
+
+    LevelDesc desc;
+    bool grid = false;                  // laid out by the first tile directive
+    bool spawn_set = false, goal_set = false;
+    int origin_x = 0, origin_z = 0, cell = 1;
+    int width = 0, depth = 0;
+    LevelPoint spawn = {0, 0}, goal = {0, 0};
+
+    char buffer[256];
+    int line = 0;
+    while (fgets(buffer, sizeof(buffer), in)) {
+        line++;
+        char * hash = strchr(buffer, '#');
+        if (hash)
+            *hash = 0;
+
+        char word[32];
+        int a, b, c;
+        int n = sscanf(buffer, "%31s %d %d %d", word, &a, &b, &c);
+        if (n <= 0)
+            continue;
+        string key = word;
+        const char * error = NULL;
+
+        if (key == "size" || key == "origin" || key == "cell") {
+            if (grid)
+                error = "size, origin and cell must come before any tiles";
+            else if (key == "size" && n == 3 && a > 0 && b > 0) {
+                width = a;
+                depth = b;
+            }
+            else if (key == "origin" && n == 3) {
+                origin_x = a;
+                origin_z = b;
+            }
+            else if (key == "cell" && n == 2 && a > 0)
+                cell = a;
+            else
+                error = "malformed directive";
+        }
+        else if (key == "spawn" && n == 3) {
+            spawn.x = a;
+            spawn.z = b;
+            spawn_set = true;
+        }
+        else if (key == "goal" && n == 3) {
+            goal.x = a;
+            goal.z = b;
+            goal_set = true;
+        }
+        else if ((key == "hole" && n == 3) || (key == "obstacle" && n == 3) ||
+                 (key == "material" && n == 4 && c >= 0 && c < 16)) {
+            if (!grid && width > 0) {
+                level_desc_init(&desc, width, depth, origin_x, origin_z, cell);
+                grid = true;
+            }
+            int flags = key == "hole" ? TILE_HOLE : key == "obstacle" ? TILE_OBSTACLE : c << TILE_MATERIAL_SHIFT;
+            if (!grid)
+                error = "size must come before any tiles";
+            else if (!level_desc_mark(&desc, a, b, flags))
+                error = "position is not on the grid";
+        }
+        else
+            error = "unknown or malformed directive";
+
+        if (error) {
+            fclose(in);
+            return fail(in_path, line, error);
+        }
+    }
+    fclose(in);
+
+    if (width == 0)
+        return fail(in_path, line, "missing size");
+    if (!grid)
+        level_desc_init(&desc, width, depth, origin_x, origin_z, cell);
+    if (spawn_set)
+        desc.spawn = spawn;
+    if (goal_set)
+        desc.goal = goal;
+
+    return level_write(&desc, out_path) ? 0 : 1;
+}
+
+static int dump(const char * path)
+{
+    Level level;
+    if (!level_open(&level, path))
+        return 1;
+
+    const LevelHeader * h = level.header;
+    printf("size %u %u\n", h->width, h->depth);
+    printf("origin %d %d\n", h->origin_x, h->origin_z);
+    printf("cell %d\n", h->cell_size);
+    printf("spawn %d %d\n", h->spawn.x, h->spawn.z);
+    printf("goal %d %d\n", h->goal.x, h->goal.z);
+
+    vector<uint8_t> tiles((size_t)h->width*h->depth);
+    for (uint32_t cz=0; cz<h->depth; cz++)
+        tile_runs_decode_row(&level.tiles, cz, &tiles[(size_t)cz*h->width]);
+    // Holes, then obstacles, then materials, like the hand written files
+    for (int pass=0; pass<3; pass++)
+        for (uint32_t cz=0; cz<h->depth; cz++)
+            for (uint32_t cx=0; cx<h->width; cx++) {
+                int tile = tiles[(size_t)cz*h->width + cx];
+                int x = h->origin_x + (int)cx*h->cell_size, z = h->origin_z + (int)cz*h->cell_size;
+                if (pass == 0 && (tile & TILE_HOLE))
+                    printf("hole %d %d\n", x, z);
+                else if (pass == 1 && (tile & TILE_OBSTACLE))
+                    printf("obstacle %d %d\n", x, z);
+                else if (pass == 2 && (tile >> TILE_MATERIAL_SHIFT))
+                    printf("material %d %d %d\n", x, z, tile >> TILE_MATERIAL_SHIFT);
+            }
+    level_close(&level);
+    return 0;
+}
+
+int main (int argc, char** argv)
+{
+    if (argc == 3 && strcmp(argv[1], "-d") == 0)
+        return dump(argv[2]);
+    if (argc == 3)
+        return compile(argv[1], argv[2]);
+    printf("usage: %s in.txt out.lvl\n       %s -d in.lvl\n", argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,143 @@
+/* Checks that levels can be finished, on every core.
+ *
+ *   usage: levelcheck [-t threads] [-q] in.lvl...
+ *          levelcheck [-t threads] [-q] -g count width depth
+ *
+ * The first form checks level files. The second generates 'count' levels
+ * with seeds 1..count and the default densities and checks them in memory.
+ * Each level is reported with the length of its shortest path from spawn to
+ * goal, or as unreachable. -q only reports the failures. The exit status is
+ * 1 if any level is invalid or cannot be finished.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "level_gen.h"
+#include "level_solve.h"
+
+using namespace std;
+
+#define LEVEL_INVALID -2
+
+struct Batch {
+    vector<string> paths;       // empty when generating
+    int count;
+    LevelGenParams gen;
+    vector<int> results;
+    atomic<int> next;
+};
+
+static int check_one(Batch * batch, int i, LevelSolver * solver)
+{
+    Level level;
+    if (batch->paths.empty()) {
+        LevelGenParams params = batch->gen;
+        params.seed = i + 1;
+        params.threads = 1;     // the batch already keeps every core busy
+        LevelDesc desc;
+        vector<unsigned char> bytes;
+        if (!level_generate(&desc, &params))
+            return LEVEL_INVALID;
+        level_serialize(&desc, bytes);
+        if (!level_from_memory(&level, &bytes[0], bytes.size()))
+            return LEVEL_INVALID;
+        return level_solve(solver, &level);
+    }
+    if (!level_open(&level, batch->paths[i].c_str()))
+        return LEVEL_INVALID;
+    int moves = level_solve(solver, &level);
+    level_close(&level);
+    return moves;
+}
+
+static void worker(Batch * batch)
+{
+    LevelSolver solver;
+    for (int i; (i = batch->next++) < batch->count; )
+        batch->results[i] = check_one(batch, i, &solver);
+}
+
+static int usage(const char * name)
+{
+    printf("usage: %s [-t threads] [-q] in.lvl...\n       %s [-t threads] [-q] -g count width depth\n",
+           name, name);
+    return 1;
+}
+
+int main (int argc, char** argv)
+{
+    Batch batch;
+    level_gen_defaults(&batch.gen);
+    batch.count = 0;
+    int threads = 0;
+    bool quiet = false, generate = false;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-q") == 0)
+            quiet = true;
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            generate = true;
+            batch.count = atoi(argv[++i]);
+        }
+        else
+            return usage(argv[0]);
+    }
+    if (generate) {
+        if (argc - i != 2 || batch.count <= 0)
+            return usage(argv[0]);
+        batch.gen.width = atoi(argv[i]);
+        batch.gen.depth = atoi(argv[i + 1]);
+    }
+    else {
+        if (i == argc)
+            return usage(argv[0]);
+        batch.paths.assign(argv + i, argv + argc);
+        batch.count = batch.paths.size();
+    }
+
+    if (threads <= 0)
+        threads = thread::hardware_concurrency();
+    threads = max(1, min(threads, batch.count));
+    batch.results.assign(batch.count, LEVEL_INVALID);
+    batch.next = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t=1; t<threads; t++)
+        workers.push_back(thread(worker, &batch));
+    worker(&batch);
+    for (size_t t=0; t<workers.size(); t++)
+        workers[t].join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int unreachable = 0, invalid = 0;
+    for (int n=0; n<batch.count; n++) {
+        char name[32];
+        if (generate)
+            snprintf(name, sizeof(name), "seed %d", n + 1);
+        const char * label = generate ? name : batch.paths[n].c_str();
+        int moves = batch.results[n];
+        if (moves == LEVEL_INVALID) {
+            invalid++;
+            printf("%s: invalid level\n", label);
+        }
+        else if (moves == LEVEL_UNREACHABLE) {
+            unreachable++;
+            printf("%s: goal unreachable\n", label);
+        }
+        else if (!quiet)
+            printf("%s: %d moves\n", label, moves);
+    }
+    printf("%d levels, %d unreachable, %d invalid, %.1f levels/s on %d threads\n",
+           batch.count, unreachable, invalid, batch.count / seconds, threads);
+    return unreachable || invalid ? 1 : 0;
+}
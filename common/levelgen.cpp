@@ -0,0 +1,72 @@
+/* Writes a randomly generated level in the binary level format.
+ *
+ *   usage: levelgen [options] width depth out.lvl
+ *
+ *   -s seed       random seed (default 1)
+ *   -H density    fraction of cells that are holes (default 0.15)
+ *   -O density    fraction of cells that hold an obstacle (default 0.05)
+ *   -t threads    worker threads, 0 for one per core (default 0)
+ *   -m            give tiles random materials (default plain floor)
+ *
+ * The same seed and options always give the same file.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "level_gen.h"
+
+using namespace std;
+
+static int usage(const char * name)
+{
+    printf("usage: %s [-s seed] [-H holes] [-O obstacles] [-t threads] [-m] width depth out.lvl\n", name);
+    return 1;
+}
+
+int main (int argc, char** argv)
+{
+    LevelGenParams params;
+    level_gen_defaults(&params);
+
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        const char * value = argv[i + 1];
+        if (strcmp(argv[i], "-m") == 0) {
+            params.materials = true;
+            i--;
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+            params.seed = strtoull(value, NULL, 0);
+        else if (strcmp(argv[i], "-H") == 0)
+            params.hole_density = atof(value);
+        else if (strcmp(argv[i], "-O") == 0)
+            params.obstacle_density = atof(value);
+        else if (strcmp(argv[i], "-t") == 0)
+            params.threads = atoi(value);
+        else
+            return usage(argv[0]);
+    }
+    if (argc - i != 3)
+        return usage(argv[0]);
+    params.width = atoi(argv[i]);
+    params.depth = atoi(argv[i + 1]);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    LevelDesc desc;
+    if (!level_generate(&desc, &params))
+        return 1;
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("%d x %d tiles generated in %.1f ms\n", params.width, params.depth, ms);
+
+    if (!level_write(&desc, argv[i + 2]))
+        return 1;
+    Level level;
+    if (!level_open(&level, argv[i + 2]))
+        return 1;
+    printf("%u runs, %u raw rows, %zu bytes for %zu tiles\n", level.header->num_runs, level.header->num_raw_rows,
+           level.map_size, desc.tiles.size());
+    level_close(&level);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include "occupancy.h"
+
+void occupancy_build(Occupancy * occ, const Level * level)
+{
+    const LevelHeader * h = level->header;
+    occ->origin_x = h->origin_x;
+    occ->origin_z = h->origin_z;
+    occ->cell_size = h->cell_size;
+    occ->width = h->width;
+    occ->depth = h->depth;
+
+    uint64_t cells = (uint64_t)h->width*h->depth;
+    occ->words.assign((cells + 31) / 32, 0);
+    const TileRuns * runs = &level->tiles;
+    for (uint32_t cz=0; cz<h->depth; cz++) {
+        TileRowWalk walk;
+        TileSpan span;
+        tile_row_begin(&walk, runs, 0, cz);
+        while (tile_row_next(&walk, &span)) {
+            // TILE_HOLE and TILE_OBSTACLE double as the OCC_ bits
+            uint64_t bits = span.tile & (TILE_HOLE | TILE_OBSTACLE);
+            if (!bits)
+                continue;
+            uint64_t row = (uint64_t)cz*h->width;
+            for (uint64_t i=row + span.start; i<row + span.end; i++)
+                occ->words[i >> 5] |= bits << ((i & 31)*2);
+        }
+    }
+}
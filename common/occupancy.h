@@ -0,0 +1,40 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "level.h"
+
+/* What a cell holds. Holes and obstacles can share a cell */
+#define OCC_FLOOR    0
+#define OCC_HOLE     1
+#define OCC_OBSTACLE 2
+#define OCC_OUTSIDE  4
+
+/* Packed 2 bit per cell view of a level, 32 cells to a word, so the whole
+   grid of a large level stays in cache and a query is a single load */
+struct Occupancy {
+    int origin_x;
+    int origin_z;
+    int cell_size;
+    unsigned int width;
+    unsigned int depth;
+    std::vector<uint64_t> words;
+};
+
+void occupancy_build(Occupancy * occ, const Level * level);
+
+/* OCC_* bits for the cell at world position (x, z) */
+static inline int occupancy_at(const Occupancy * occ, int x, int z)
+{
+    // Positions left of or below the origin wrap to huge unsigned values
+    unsigned int cx = (unsigned int)(x - occ->origin_x) / occ->cell_size;
+    unsigned int cz = (unsigned int)(z - occ->origin_z) / occ->cell_size;
+    if (cx >= occ->width || cz >= occ->depth)
+        return OCC_OUTSIDE;
+    uint64_t index = (uint64_t)cz*occ->width + cx;
+    return (occ->words[index >> 5] >> ((index & 31)*2)) & 3;
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include "offscreen.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+/* The few GL calls made here, looked up from the context rather than
+   linked, the programs each bring their own loader */
+static PFNGLGENFRAMEBUFFERSPROC gen_framebuffers;
+static PFNGLBINDFRAMEBUFFERPROC bind_framebuffer;
+static PFNGLDELETEFRAMEBUFFERSPROC delete_framebuffers;
+static PFNGLGENRENDERBUFFERSPROC gen_renderbuffers;
+static PFNGLBINDRENDERBUFFERPROC bind_renderbuffer;
+static PFNGLDELETERENDERBUFFERSPROC delete_renderbuffers;
+static PFNGLRENDERBUFFERSTORAGEPROC renderbuffer_storage;
+static PFNGLFRAMEBUFFERRENDERBUFFERPROC framebuffer_renderbuffer;
+static PFNGLCHECKFRAMEBUFFERSTATUSPROC check_framebuffer_status;
+static void (*viewport)(GLint, GLint, GLsizei, GLsizei);
+static void (*finish)();
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool offscreen_parse_size(const char * arg, int * width, int * height)
+{
+    int w, h;
+    char end;
+    if (sscanf(arg, "%dx%d%c", &w, &h, &end) != 2 || w <= 0 || h <= 0)
+        return false;
+    *width = w;
+    *height = h;
+    return true;
+}
+
+void * offscreen_proc_address(const char * name)
+{
+    return (void *)eglGetProcAddress(name);
+}
+
+/* Surfaceless if Mesa offers it, whatever the default display is if not */
+static EGLDisplay open_display()
+{
+    const char * extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless") && get_platform_display)
+        return get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static bool load_functions()
+{
+    gen_framebuffers = (PFNGLGENFRAMEBUFFERSPROC)eglGetProcAddress("glGenFramebuffers");
+    bind_framebuffer = (PFNGLBINDFRAMEBUFFERPROC)eglGetProcAddress("glBindFramebuffer");
+    delete_framebuffers = (PFNGLDELETEFRAMEBUFFERSPROC)eglGetProcAddress("glDeleteFramebuffers");
+    gen_renderbuffers = (PFNGLGENRENDERBUFFERSPROC)eglGetProcAddress("glGenRenderbuffers");
+    bind_renderbuffer = (PFNGLBINDRENDERBUFFERPROC)eglGetProcAddress("glBindRenderbuffer");
+    delete_renderbuffers = (PFNGLDELETERENDERBUFFERSPROC)eglGetProcAddress("glDeleteRenderbuffers");
+    renderbuffer_storage = (PFNGLRENDERBUFFERSTORAGEPROC)eglGetProcAddress("glRenderbufferStorage");
+    framebuffer_renderbuffer = (PFNGLFRAMEBUFFERRENDERBUFFERPROC)eglGetProcAddress("glFramebufferRenderbuffer");
+    check_framebuffer_status = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)eglGetProcAddress("glCheckFramebufferStatus");
+    viewport = (void (*)(GLint, GLint, GLsizei, GLsizei))eglGetProcAddress("glViewport");
+    finish = (void (*)())eglGetProcAddress("glFinish");
+    return gen_framebuffers && bind_framebuffer && delete_framebuffers && gen_renderbuffers &&
+           bind_renderbuffer && delete_renderbuffers && renderbuffer_storage &&
+           framebuffer_renderbuffer && check_framebuffer_status && viewport && finish;
+}
+
+bool offscreen_open(Offscreen * off, int width, int height)
+{
+    memset(off, 0, sizeof(*off));
+    EGLDisplay display = open_display();
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        printf("No EGL display for offscreen rendering\n");
+        return false;
+    }
+    off->display = display;
+    const char * extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context")) {
+        printf("EGL %d.%d has no surfaceless contexts\n", major, minor);
+        offscreen_close(off);
+        return false;
+    }
+
+    // Any surface type, the default asks for windows
+    static const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, 0,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint num_configs;
+    if (!eglBindAPI(EGL_OPENGL_API) ||
+        !eglChooseConfig(display, config_attribs, &config, 1, &num_configs) || num_configs == 0) {
+        printf("EGL has no desktop GL config\n");
+        offscreen_close(off);
+        return false;
+    }
+    static const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    off->context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (off->context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)off->context)) {
+        printf("Could not create a GL 3.3 core context\n");
+        offscreen_close(off);
+        return false;
+    }
+    if (!load_functions()) {
+        printf("The offscreen context has no framebuffer objects\n");
+        offscreen_close(off);
+        return false;
+    }
+
+    off->width = width;
+    off->height = height;
+    gen_renderbuffers(1, &off->color);
+    bind_renderbuffer(GL_RENDERBUFFER, off->color);
+    renderbuffer_storage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    gen_renderbuffers(1, &off->depth);
+    bind_renderbuffer(GL_RENDERBUFFER, off->depth);
+    renderbuffer_storage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    gen_framebuffers(1, &off->framebuffer);
+    bind_framebuffer(GL_FRAMEBUFFER, off->framebuffer);
+    framebuffer_renderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, off->color);
+    framebuffer_renderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, off->depth);
+    if (check_framebuffer_status(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Could not make a %dx%d framebuffer\n", width, height);
+        offscreen_close(off);
+        return false;
+    }
+    viewport(0, 0, width, height);
+    return true;
+}
+
+void offscreen_close(Offscreen * off)
+{
+    if (off->framebuffer) {
+        delete_framebuffers(1, &off->framebuffer);
+        delete_renderbuffers(1, &off->color);
+        delete_renderbuffers(1, &off->depth);
+    }
+    if (off->context) {
+        eglMakeCurrent((EGLDisplay)off->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay)off->display, (EGLContext)off->context);
+    }
+    if (off->display)
+        eglTerminate((EGLDisplay)off->display);
+    memset(off, 0, sizeof(*off));
+}
+
+void offscreen_bench(Offscreen * off, int frames, bool (*draw_frame)())
+{
+    std::vector<double> times;
+    times.reserve(frames > 0 ? frames : 0);
+    double start = now();
+    while ((int)times.size() < frames) {
+        double begin = now();
+        if (!draw_frame())
+            break;
+        finish();
+        times.push_back(now() - begin);
+    }
+    double total = now() - start;
+    frames = times.size();
+    if (frames == 0) {
+        printf("No frames drawn\n");
+        return;
+    }
+
+    std::sort(times.begin(), times.end());
+    printf("%d frames at %dx%d in %.3f s, %.1f frames/s\n", frames, off->width, off->height, total, frames / total);
+    printf("  mean %.3f ms, min %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms\n",
+           total / frames * 1000, times[0] * 1000, times[frames / 2] * 1000,
+           times[(int)(frames * 0.95)] * 1000, times[frames - 1] * 1000);
+}
@@ -0,0 +1,38 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+/* GL without a window, for timing draw() on machines with no display.
+ *
+ * The context comes from EGL on Mesa's surfaceless platform (llvmpipe when
+ * there is no GPU), so no X server is needed. It has no default framebuffer;
+ * everything is drawn into a framebuffer object of the size asked for,
+ * which stays bound. Nothing is ever shown, so frames are timed to
+ * glFinish() rather than a swap.
+ */
+struct Offscreen {
+    void * display;             // EGLDisplay
+    void * context;             // EGLContext
+    int width;
+    int height;
+    unsigned int framebuffer;
+    unsigned int color;         // renderbuffers attached to it
+    unsigned int depth;
+};
+
+/* A --offscreen argument, "WIDTHxHEIGHT" */
+bool offscreen_parse_size(const char * arg, int * width, int * height);
+
+/* Creates a GL 3.3 core context, makes it current on the calling thread
+   and binds a width x height framebuffer with colour and depth */
+bool offscreen_open(Offscreen * off, int width, int height);
+void offscreen_close(Offscreen * off);
+
+/* GL entry points of the offscreen context, for the programs' loaders */
+void * offscreen_proc_address(const char * name);
+
+/* Calls draw_frame up to 'frames' times, waiting for each frame to finish,
+   and prints how long they took. draw_frame returns false, having drawn
+   nothing, to end the run early */
+void offscreen_bench(Offscreen * off, int frames, bool (*draw_frame)());
+
+#endif
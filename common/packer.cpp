@@ -0,0 +1,118 @@
+/* Builds an asset pack out of loose files.
+   Usage: packer out.pak file...
+   Each file is stored under the path given on the command line, so run it
+   from the directory the program loads its assets from. */
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "asset_pack.h"
+
+using namespace std;
+
+struct Input {
+    string name;
+    vector<unsigned char> bytes;
+};
+
+static bool by_name(const Input & a, const Input & b)
+{
+    return a.name < b.name;
+}
+
+static bool read_file(const char * path, vector<unsigned char> & bytes)
+{
+    FILE * file = fopen(path, "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    bytes.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    fclose(file);
+    return ok;
+}
+
+/* The pack is little endian whatever the machine building it */
+static void put_le(unsigned char * out, uint64_t value, int bytes)
+{
+    for (int i=0; i<bytes; i++)
+        out[i] = (unsigned char)(value >> 8*i);
+}
+
+static uint64_t align_up(uint64_t value)
+{
+    return (value + PACK_ALIGN - 1) & ~(uint64_t)(PACK_ALIGN - 1);
+}
+
+int main (int argc, char** argv)
+{
+    if (argc < 3) {
+        printf("usage: %s out.pak file...\n", argv[0]);
+        return 1;
+    }
+
+    vector<Input> inputs(argc - 2);
+    for (int i=2; i<argc; i++) {
+        Input & in = inputs[i-2];
+        in.name = argv[i];
+        if (in.name.size() >= PACK_NAME_LEN) {
+            printf("Name too long for the pack index: %s\n", argv[i]);
+            return 1;
+        }
+        if (!read_file(argv[i], in.bytes)) {
+            printf("Could not read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    sort(inputs.begin(), inputs.end(), by_name);
+    for (size_t i=1; i<inputs.size(); i++) {
+        if (inputs[i].name == inputs[i-1].name) {
+            printf("Duplicate entry %s\n", inputs[i].name.c_str());
+            return 1;
+        }
+    }
+
+    // Lay out the blobs after the index
+    vector<PackEntry> entries(inputs.size());
+    uint64_t offset = sizeof(PackHeader) + entries.size()*sizeof(PackEntry);
+    for (size_t i=0; i<inputs.size(); i++) {
+        memset(&entries[i], 0, sizeof(PackEntry));
+        strcpy(entries[i].name, inputs[i].name.c_str());
+        entries[i].offset = align_up(offset);
+        entries[i].size = inputs[i].bytes.size();
+        offset = entries[i].offset + entries[i].size + 1; // NUL terminator
+    }
+
+    vector<unsigned char> out(offset, 0);
+    unsigned char * header = out.data();
+    memcpy(header + offsetof(PackHeader, magic), PACK_MAGIC, 4);
+    put_le(header + offsetof(PackHeader, version), PACK_VERSION, 4);
+    put_le(header + offsetof(PackHeader, count), entries.size(), 4);
+    put_le(header + offsetof(PackHeader, entry_size), sizeof(PackEntry), 4);
+    put_le(header + offsetof(PackHeader, file_size), offset, 8);
+    for (size_t i=0; i<entries.size(); i++) {
+        unsigned char * entry = out.data() + sizeof(PackHeader) + i*sizeof(PackEntry);
+        memcpy(entry + offsetof(PackEntry, name), entries[i].name, PACK_NAME_LEN);
+        put_le(entry + offsetof(PackEntry, offset), entries[i].offset, 8);
+        put_le(entry + offsetof(PackEntry, size), entries[i].size, 8);
+    }
+    for (size_t i=0; i<inputs.size(); i++)
+        if (!inputs[i].bytes.empty())
+            memcpy(out.data() + entries[i].offset, inputs[i].bytes.data(), inputs[i].bytes.size());
+
+    FILE * file = fopen(argv[1], "wb");
+    if (!file || fwrite(out.data(), 1, out.size(), file) != out.size()) {
+        printf("Could not write %s\n", argv[1]);
+        if (file)
+            fclose(file);
+        return 1;
+    }
+    fclose(file);
+    printf("%s: %zu entries, %llu bytes\n", argv[1], inputs.size(), (unsigned long long)offset);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "sim_thread.h"
+
+#include <chrono>
+
+double sim_thread_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Runs the step due at sim->next, which the clock has reached, skipping
+   ahead first if it is more than max_lag behind. False once run_step has
+   returned false */
+static bool run_one(SimThread * sim, double now)
+{
+    if (now - sim->next > sim->max_lag)
+        sim->next = now - sim->max_lag;
+    if (!sim->run_step(sim->next)) {
+        sim->finished = true;
+        return false;
+    }
+    sim->next += sim->step;
+    return true;
+}
+
+static void run(SimThread * sim)
+{
+    while (!sim->quit.load(std::memory_order_relaxed)) {
+        double now = sim_thread_now();
+        if (now < sim->next) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(sim->next - now));
+            continue;
+        }
+        if (!run_one(sim, now))
+            return;
+    }
+}
+
+void sim_thread_manual(SimThread * sim, double step, double max_lag, bool (*run_step)(double time))
+{
+    sim->step = step;
+    sim->max_lag = max_lag;
+    sim->run_step = run_step;
+    sim->next = sim_thread_now();
+    sim->quit = false;
+    sim->finished = false;
+}
+
+void sim_thread_start(SimThread * sim, double step, double max_lag, bool (*run_step)(double time))
+{
+    sim_thread_manual(sim, step, max_lag, run_step);
+    sim->thread = std::thread(run, sim);
+}
+
+bool sim_thread_run_due(SimThread * sim, double now)
+{
+    while (now >= sim->next)
+        if (!run_one(sim, now))
+            return false;
+    return true;
+}
+
+void sim_thread_stop(SimThread * sim)
+{
+    sim->quit = true;
+    if (sim->thread.joinable())
+        sim->thread.join();
+}
@@ -0,0 +1,38 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include <atomic>
+#include <thread>
+
+/* Runs a program's fixed step simulation on a thread of its own, in step
+ * with real time: the step for 'time' runs once the clock reaches it, and
+ * steps are 'step' seconds apart. After a stall it drops steps rather than
+ * running more than 'max_lag' seconds of them back to back. A slow frame on
+ * the render thread no longer holds the game up.
+ */
+struct SimThread {
+    double step;
+    double max_lag;
+    bool (*run_step)(double time);  // returning false stops the thread
+    double next;                    // when the next step is due
+    std::thread thread;
+    std::atomic<bool> quit;
+    std::atomic<bool> finished;     // run_step returned false
+};
+
+void sim_thread_start(SimThread * sim, double step, double max_lag, bool (*run_step)(double time));
+/* Same stepping, but without a thread: the caller runs the due steps itself
+   with sim_thread_run_due(), for a loop that wants them at a moment of its
+   choosing. sim_thread_stop() is still safe to call */
+void sim_thread_manual(SimThread * sim, double step, double max_lag, bool (*run_step)(double time));
+/* Runs every step due by 'now', at most 'max_lag' seconds of them. Returns
+   false, and sets 'finished', once run_step has returned false */
+bool sim_thread_run_due(SimThread * sim, double now);
+
+/* Asks the thread to stop after the step it is on and joins it */
+void sim_thread_stop(SimThread * sim);
+
+/* Seconds on the clock the steps are timed by */
+double sim_thread_now();
+
+#endif
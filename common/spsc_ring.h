@@ -0,0 +1,56 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stdint.h>
+
+/* Fixed size queue between exactly one producer thread and one consumer
+ * thread. Neither side locks or waits: push fails when the ring is full and
+ * pop when it is empty. N must be a power of two.
+ *
+ * head and tail only ever count up and are masked on use, so a full ring
+ * (tail - head == N) and an empty one (tail == head) are told apart without
+ * giving up a slot. Each index is written by one side only and sits on its
+ * own cache line, so the two threads do not keep stealing it from each other.
+ */
+template <typename T, uint32_t N>
+struct SpscRing {
+    T items[N];
+    alignas(64) std::atomic<uint32_t> head;     // next to pop, consumer only
+    alignas(64) std::atomic<uint32_t> tail;     // next to push, producer only
+};
+
+/* Not safe while either side is using the ring */
+template <typename T, uint32_t N>
+void spsc_ring_init(SpscRing<T, N> * ring)
+{
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/* Producer side. False, dropping 'item', when the ring is full */
+template <typename T, uint32_t N>
+bool spsc_ring_push(SpscRing<T, N> * ring, const T & item)
+{
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (tail - ring->head.load(std::memory_order_acquire) == N)
+        return false;
+    ring->items[tail & (N - 1)] = item;
+    ring->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+/* Consumer side. False when there is nothing to take */
+template <typename T, uint32_t N>
+bool spsc_ring_pop(SpscRing<T, N> * ring, T * item)
+{
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if (head == ring->tail.load(std::memory_order_acquire))
+        return false;
+    *item = ring->items[head & (N - 1)];
+    ring->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+#endif
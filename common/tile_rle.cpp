@@ -0,0 +1,119 @@
+#include "tile_rle.h"
+
+#include <string.h>
+
+uint32_t tile_runs_find(const TileRuns * runs, uint32_t cx, uint32_t cz)
+{
+    // First run of the row that ends after cx
+    uint32_t lo = runs->row_index[cz], hi = runs->row_index[cz + 1] - 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo)/2;
+        if (runs->run_end[mid] <= cx)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void tile_row_begin(TileRowWalk * walk, const TileRuns * runs, uint32_t cx, uint32_t cz)
+{
+    walk->runs = runs;
+    walk->raw = tile_runs_raw(runs, cz);
+    walk->cell = cx;
+    walk->run = 0;
+    if (!walk->raw)
+        walk->run = cx < runs->width ? tile_runs_find(runs, cx, cz) : runs->row_index[cz + 1];
+}
+
+bool tile_row_next(TileRowWalk * walk, TileSpan * span)
+{
+    const TileRuns * runs = walk->runs;
+    if (walk->cell >= runs->width)
+        return false;
+    span->start = walk->cell;
+    if (walk->raw) {
+        // Merged on the way, so callers see the same spans either way
+        span->tile = walk->raw[walk->cell];
+        span->end = walk->cell + 1;
+        while (span->end < runs->width && walk->raw[span->end] == span->tile)
+            span->end++;
+    }
+    else {
+        span->tile = runs->run_tile[walk->run];
+        span->end = runs->run_end[walk->run];
+        walk->run++;
+    }
+    walk->cell = span->end;
+    return true;
+}
+
+void tile_runs_decode_row(const TileRuns * runs, uint32_t cz, uint8_t * out)
+{
+    const uint8_t * raw = tile_runs_raw(runs, cz);
+    if (raw) {
+        memcpy(out, raw, runs->width);
+        return;
+    }
+    uint32_t start = 0;
+    for (uint32_t r=runs->row_index[cz]; r<runs->row_index[cz + 1]; r++) {
+        memset(out + start, runs->run_tile[r], runs->run_end[r] - start);
+        start = runs->run_end[r];
+    }
+}
+
+bool tile_runs_valid(const TileRuns * runs)
+{
+    if (runs->row_index[0] != 0 || runs->row_index[runs->depth] != runs->num_runs)
+        return false;
+    uint32_t raw_rows = 0;
+    for (uint32_t cz=0; cz<runs->depth; cz++) {
+        uint32_t first = runs->row_index[cz], last = runs->row_index[cz + 1];
+        if (runs->raw_row[cz] != TILE_ROW_RUNS) {
+            // Raw rows have no runs and come in order
+            if (last != first || runs->raw_row[cz] != raw_rows)
+                return false;
+            raw_rows++;
+            continue;
+        }
+        // Every other row has at least one run, and its runs end at the row's end
+        if (last <= first || last > runs->num_runs || runs->run_end[last - 1] != runs->width)
+            return false;
+        uint32_t start = 0;
+        for (uint32_t r=first; r<last; r++) {
+            if (runs->run_end[r] <= start)
+                return false;
+            start = runs->run_end[r];
+        }
+    }
+    return raw_rows == runs->num_raw_rows;
+}
+
+void tile_runs_encode(const uint8_t * tiles, uint32_t width, uint32_t depth, TileRunsData * out)
+{
+    out->row_index.resize(depth + 1);
+    out->raw_row.resize(depth);
+    out->run_end.clear();
+    out->run_tile.clear();
+    out->raw_tile.clear();
+    uint32_t raw_rows = 0;
+    for (uint32_t cz=0; cz<depth; cz++) {
+        const uint8_t * row = tiles + (size_t)cz*width;
+        out->row_index[cz] = out->run_end.size();
+        out->raw_row[cz] = TILE_ROW_RUNS;
+        size_t first = out->run_end.size();
+        for (uint32_t cx=1; cx<=width; cx++)
+            if (cx == width || row[cx] != row[cx - 1]) {
+                out->run_end.push_back(cx);
+                out->run_tile.push_back(row[cx - 1]);
+            }
+        // Five bytes a run against one a cell
+        if ((out->run_end.size() - first)*(sizeof(uint32_t) + 1) > width) {
+            out->run_end.resize(first);
+            out->run_tile.resize(first);
+            out->raw_row[cz] = raw_rows++;
+            out->raw_tile.insert(out->raw_tile.end(), row, row + width);
+        }
+    }
+    out->row_index[depth] = out->run_end.size();
+}
@@ -0,0 +1,100 @@
+#ifndef TILE_RLE_H
+#define TILE_RLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Run length encoded tile grid. Every row is a list of runs of identical
+ * tiles, and row_index[cz] is the first run of row cz, so a row is found in
+ * O(1) and a cell by binary search inside its row:
+ *
+ *   runs row_index[cz] .. row_index[cz + 1] - 1 make up row cz
+ *   run r covers cells run_end[r - 1] .. run_end[r] - 1 of its row
+ *   (from cell 0 for the first run of a row) and holds run_tile[r]
+ *
+ * A run takes five bytes, so a busy row can take more as runs than as one
+ * byte per cell. Such a row is stored raw instead. It has no runs, and its
+ * cells are raw_tile[raw_row[cz]*width ..]. raw_row[cz] is TILE_ROW_RUNS
+ * for the rows that are run length encoded.
+ *
+ * A level that is mostly plain floor needs a handful of runs per row
+ * instead of a byte per cell, and a busy one costs little more than the
+ * bytes. The arrays can point into a mapped file.
+ */
+#define TILE_ROW_RUNS 0xFFFFFFFFu
+
+struct TileRuns {
+    uint32_t width;
+    uint32_t depth;
+    uint32_t num_runs;
+    uint32_t num_raw_rows;
+    const uint32_t * row_index;     // depth + 1 entries
+    const uint32_t * run_end;
+    const uint8_t * run_tile;
+    const uint32_t * raw_row;       // depth entries
+    const uint8_t * raw_tile;       // num_raw_rows * width
+};
+
+/* Cells of row cz if it is stored raw, NULL if it is runs */
+static inline const uint8_t * tile_runs_raw(const TileRuns * runs, uint32_t cz)
+{
+    uint32_t raw = runs->raw_row[cz];
+    return raw == TILE_ROW_RUNS ? NULL : runs->raw_tile + (size_t)raw*runs->width;
+}
+
+/* Run holding cell (cx, cz), for a row that is not raw */
+uint32_t tile_runs_find(const TileRuns * runs, uint32_t cx, uint32_t cz);
+
+static inline uint8_t tile_runs_at(const TileRuns * runs, uint32_t cx, uint32_t cz)
+{
+    const uint8_t * raw = tile_runs_raw(runs, cz);
+    return raw ? raw[cx] : runs->run_tile[tile_runs_find(runs, cx, cz)];
+}
+
+/* Cells start .. end - 1 of a row, all holding 'tile' */
+struct TileSpan {
+    uint32_t start;
+    uint32_t end;
+    uint8_t tile;
+};
+
+/* Walks one row in spans of identical tiles, whichever way it is stored:
+ *
+ *   TileRowWalk walk;
+ *   TileSpan span;
+ *   tile_row_begin(&walk, runs, cx, cz);
+ *   while (tile_row_next(&walk, &span))
+ *       ...
+ *
+ * The first span starts at cx, the last one ends at the end of the row.
+ */
+struct TileRowWalk {
+    const TileRuns * runs;
+    const uint8_t * raw;        // the row's cells, if it is raw
+    uint32_t run;               // next run, if it is not
+    uint32_t cell;              // first cell of the next span
+};
+
+void tile_row_begin(TileRowWalk * walk, const TileRuns * runs, uint32_t cx, uint32_t cz);
+bool tile_row_next(TileRowWalk * walk, TileSpan * span);
+
+/* Expands row cz into 'width' bytes */
+void tile_runs_decode_row(const TileRuns * runs, uint32_t cz, uint8_t * out);
+
+/* Checks the index, run ends and raw rows are consistent with the grid size */
+bool tile_runs_valid(const TileRuns * runs);
+
+/* Encoded form of a row major tile array, for writing out */
+struct TileRunsData {
+    std::vector<uint32_t> row_index;
+    std::vector<uint32_t> run_end;
+    std::vector<uint8_t> run_tile;
+    std::vector<uint32_t> raw_row;
+    std::vector<uint8_t> raw_tile;
+};
+
+/* Each row goes in whichever form is smaller */
+void tile_runs_encode(const uint8_t * tiles, uint32_t width, uint32_t depth, TileRunsData * out);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+/* Hands the latest value of a T from one writer thread to one reader thread
+ * without either of them ever waiting. Of the three slots the writer owns
+ * one (back) and the reader one (front); publishing swaps the back slot with
+ * the middle one, and the reader swaps the middle one into front when it
+ * holds something new. Values the reader did not get round to are dropped.
+ *
+ * A published slot is not touched again until the reader has let go of it,
+ * so the reader can use what it got for as long as it likes.
+ */
+#define TRIPLE_SLOT  3
+#define TRIPLE_FRESH 4      // middle holds a value the reader has not seen
+
+template <typename T>
+struct TripleBuffer {
+    T slots[3];
+    int back;                   // writer only
+    int front;                  // reader only
+    std::atomic<int> middle;    // slot index, TRIPLE_FRESH when new
+};
+
+template <typename T>
+void triple_buffer_init(TripleBuffer<T> * buffer)
+{
+    buffer->back = 0;
+    buffer->middle = 1;
+    buffer->front = 2;
+}
+
+/* Slot for the writer to fill. Holds an old value, not the last published */
+template <typename T>
+T * triple_buffer_back(TripleBuffer<T> * buffer)
+{
+    return &buffer->slots[buffer->back];
+}
+
+template <typename T>
+void triple_buffer_publish(TripleBuffer<T> * buffer)
+{
+    int old = buffer->middle.exchange(buffer->back | TRIPLE_FRESH, std::memory_order_acq_rel);
+    buffer->back = old & TRIPLE_SLOT;
+}
+
+/* Takes the newest published value if there is one. Returns false, keeping
+   the current front, when nothing was published since the last call */
+template <typename T>
+bool triple_buffer_update(TripleBuffer<T> * buffer)
+{
+    if (!(buffer->middle.load(std::memory_order_relaxed) & TRIPLE_FRESH))
+        return false;
+    int old = buffer->middle.exchange(buffer->front, std::memory_order_acq_rel);
+    buffer->front = old & TRIPLE_SLOT;
+    return true;
+}
+
+template <typename T>
+const T * triple_buffer_front(const TripleBuffer<T> * buffer)
+{
+    return &buffer->slots[buffer->front];
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "vblank.h"
+
+#include <math.h>
+#include <chrono>
+#include <thread>
+
+#include "sim_thread.h"
+
+/* How fast the estimates follow new measurements */
+#define PERIOD_RATE 0.05
+#define RENDER_DECAY 0.02
+
+/* Sleeping any closer to a deadline than this tends to overshoot it */
+#define SPIN 0.002
+#define DEFAULT_MARGIN 0.001
+
+void vblank_init(VblankPredictor * vblank, double period)
+{
+    vblank->period = period;
+    vblank->last = 0;
+    vblank->render = period / 2;
+    vblank->margin = DEFAULT_MARGIN;
+}
+
+double vblank_lead(const VblankPredictor * vblank)
+{
+    return vblank->render + vblank->margin;
+}
+
+double vblank_next(const VblankPredictor * vblank, double now)
+{
+    double lead = vblank_lead(vblank);
+    if (vblank->last == 0)
+        return now + lead;
+    double refreshes = ceil((now + lead - vblank->last) / vblank->period);
+    if (refreshes < 1)
+        refreshes = 1;
+    return vblank->last + refreshes*vblank->period;
+}
+
+void vblank_swapped(VblankPredictor * vblank, double start, double submit, double swapped)
+{
+    double render = submit - start;
+    if (render > vblank->render)
+        vblank->render = render;
+    else
+        vblank->render += (render - vblank->render)*RENDER_DECAY;
+
+    if (vblank->last != 0) {
+        // A swap that missed a refresh spans several periods
+        double interval = swapped - vblank->last;
+        double periods = floor(interval / vblank->period + 0.5);
+        if (periods >= 1) {
+            double measured = interval / periods;
+            if (fabs(measured - vblank->period) < vblank->period*0.1)
+                vblank->period += (measured - vblank->period)*PERIOD_RATE;
+        }
+    }
+    vblank->last = swapped;
+}
+
+void vblank_sleep_until(double when)
+{
+    double now = sim_thread_now();
+    if (when - now > SPIN)
+        std::this_thread::sleep_for(std::chrono::duration<double>(when - now - SPIN));
+    while (sim_thread_now() < when)
+        ;
+}
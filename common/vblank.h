@@ -0,0 +1,38 @@
+#ifndef VBLANK_H
+#define VBLANK_H
+
+/* Predicts when the display will next refresh, from the times a vsynced
+ * swap returns, so a loop can wait until just before it to read input and
+ * draw. The frame then shows input that is a frame fresher than polling
+ * right after the swap would give.
+ *
+ * The refresh period starts out as the nominal one and follows the measured
+ * swap intervals, which are a whole number of periods apart when frames are
+ * missed. How long a frame takes to draw is tracked as a maximum that decays
+ * slowly, so one quick frame does not make the next wake up too late.
+ */
+struct VblankPredictor {
+    double period;          // seconds between refreshes
+    double last;            // the last swap returned, taken to be a refresh
+    double render;          // from waking up to calling swap
+    double margin;          // extra headroom on top of 'render'
+};
+
+/* 'period' is what the display claims, 1/refresh rate */
+void vblank_init(VblankPredictor * vblank, double period);
+
+/* The first refresh after 'now' there is still time to draw a frame for,
+   on the sim_thread_now() clock */
+double vblank_next(const VblankPredictor * vblank, double now);
+/* How long before a refresh to start on the frame for it */
+double vblank_lead(const VblankPredictor * vblank);
+
+/* A frame begun at 'start' called swap at 'submit', which returned at
+   'swapped' */
+void vblank_swapped(VblankPredictor * vblank, double start, double submit, double swapped);
+
+/* Sleeps until 'when', spinning for the last moment of it since a sleep
+   cannot be trusted to wake up on time */
+void vblank_sleep_until(double when);
+
+#endif